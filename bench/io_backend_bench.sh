@@ -0,0 +1,26 @@
+#!/bin/sh
+#
+# Compares the threads and io_uring backends over loopback: throughput,
+# server CPU time and server system calls per command.
+#
+#   bench/io_backend_bench.sh <server binary> <loopback_bench binary> [loopback_bench options]
+#
+# Syscall counts need root and tracefs; mount it with
+#   mount -t tracefs nodev /sys/kernel/tracing
+
+set -e
+
+server=${1:?server binary}
+bench=${2:?loopback_bench binary}
+shift 2
+port=${BENCH_PORT:-7379}
+
+for backend in threads io_uring; do
+    "$server" --port "$port" --io-backend "$backend" > /dev/null 2>&1 &
+    pid=$!
+    sleep 0.5
+    echo "== $backend"
+    "$bench" --port "$port" --pid "$pid" "$@" || true
+    kill "$pid"
+    wait "$pid" 2> /dev/null || true
+done
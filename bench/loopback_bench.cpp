@@ -0,0 +1,243 @@
+// Loopback load generator for comparing the threads and io_uring backends.
+//
+//   loopback_bench [--port N] [--pid PID] [--clients N] [--requests N] [--pipeline N]
+//
+// Each client connection sends batches of --pipeline SET/GET pairs and waits
+// for every reply before sending the next batch. With --pid the server's
+// system calls are counted through the raw_syscalls:sys_enter tracepoint
+// (needs root and a mounted tracefs), together with its CPU time.
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <netinet/in.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int port = 6379;
+    int pid = 0;
+    int clients = 4;
+    long requests = 200000;   // Total commands across all clients
+    int pipeline = 16;
+};
+
+std::string encode(const std::vector<std::string>& args) {
+    std::string out = "*" + std::to_string(args.size()) + "\r\n";
+    for (const auto& arg : args) {
+        out += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    }
+    return out;
+}
+
+// Number of complete simple-string or bulk-string replies at the front of
+// buffer; consumed is set to the bytes they occupy.
+size_t countReplies(const std::string& buffer, size_t& consumed) {
+    size_t pos = 0;
+    size_t count = 0;
+    for (;;) {
+        size_t end = buffer.find("\r\n", pos);
+        if (end == std::string::npos) {
+            break;
+        }
+        if (buffer[pos] == '$') {
+            long length = std::strtol(buffer.c_str() + pos + 1, nullptr, 10);
+            if (length >= 0) {
+                if (buffer.size() < end + 2 + static_cast<size_t>(length) + 2) {
+                    break;
+                }
+                end += 2 + static_cast<size_t>(length);
+            }
+        } else if (buffer[pos] == '-') {
+            throw std::runtime_error("server error: " + buffer.substr(pos, end - pos));
+        }
+        pos = end + 2;
+        ++count;
+    }
+    consumed = pos;
+    return count;
+}
+
+void runClient(const Options& options, int id, long commands) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(options.port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        throw std::runtime_error("connect failed");
+    }
+
+    std::string batch;
+    for (int i = 0; i < options.pipeline; ++i) {
+        std::string key = "bench:" + std::to_string(id) + ":" + std::to_string(i);
+        batch += i % 2 == 0 ? encode({"SET", key, "value"}) : encode({"GET", key});
+    }
+
+    std::string input;
+    char buffer[16384];
+    for (long sent = 0; sent < commands; sent += options.pipeline) {
+        if (send(fd, batch.data(), batch.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(batch.size())) {
+            throw std::runtime_error("send failed");
+        }
+        size_t replies = 0;
+        while (replies < static_cast<size_t>(options.pipeline)) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                throw std::runtime_error("connection closed");
+            }
+            input.append(buffer, static_cast<size_t>(n));
+            size_t consumed = 0;
+            replies += countReplies(input, consumed);
+            input.erase(0, consumed);
+        }
+    }
+    close(fd);
+}
+
+// One counter per thread of pid that exists now, listed from
+// /proc/<pid>/task, so the accept loop, the io_uring event loop and the
+// expiry thread are all measured. Each counter is inherited by threads its
+// thread spawns later (one per client on the threads backend), whose counts
+// are folded in when they exit. Returns an empty vector on failure.
+std::vector<int> openSyscallCounters(int pid) {
+    std::ifstream id_file("/sys/kernel/tracing/events/raw_syscalls/sys_enter/id");
+    uint64_t id = 0;
+    if (!(id_file >> id)) {
+        errno = ENOENT;
+        return {};
+    }
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_TRACEPOINT;
+    attr.size = sizeof(attr);
+    attr.config = id;
+    attr.inherit = 1;
+    attr.disabled = 1;
+    std::vector<int> counters;
+    std::error_code ec;
+    for (const auto& task : std::filesystem::directory_iterator("/proc/" + std::to_string(pid) + "/task", ec)) {
+        int tid = std::atoi(task.path().filename().c_str());
+        int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0));
+        if (fd < 0) {
+            int saved = errno;
+            for (int counter : counters) {
+                close(counter);
+            }
+            errno = saved;
+            return {};
+        }
+        counters.push_back(fd);
+    }
+    if (ec) {
+        errno = ec.value();
+    }
+    return counters;
+}
+
+// utime + stime of every thread of pid, in clock ticks.
+long cpuTicks(int pid) {
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string content((std::istreambuf_iterator<char>(stat)), std::istreambuf_iterator<char>());
+    std::istringstream fields(content.substr(content.rfind(')') + 2));
+    std::string field;
+    long utime = 0, stime = 0;
+    for (int i = 3; i <= 15 && fields >> field; ++i) {
+        if (i == 14) utime = std::stol(field);
+        if (i == 15) stime = std::stol(field);
+    }
+    return utime + stime;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        long value = std::atol(argv[i + 1]);
+        if (arg == "--port") options.port = static_cast<int>(value);
+        else if (arg == "--pid") options.pid = static_cast<int>(value);
+        else if (arg == "--clients") options.clients = static_cast<int>(value);
+        else if (arg == "--requests") options.requests = value;
+        else if (arg == "--pipeline") options.pipeline = static_cast<int>(value);
+        else {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+    if (options.clients < 1 || options.pipeline < 2 || options.requests < 1) {
+        std::cerr << "--clients must be >= 1, --pipeline >= 2 and --requests >= 1\n";
+        return 1;
+    }
+
+    std::vector<int> counters;
+    long cpu_before = 0;
+    if (options.pid > 0) {
+        counters = openSyscallCounters(options.pid);
+        if (counters.empty()) {
+            std::cerr << "syscall counting unavailable: " << std::strerror(errno) << "\n";
+        }
+        for (int counter : counters) {
+            ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        cpu_before = cpuTicks(options.pid);
+    }
+
+    long per_client = options.requests / options.clients;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options.clients; ++i) {
+        threads.emplace_back([&, i]() {
+            try {
+                runClient(options, i, per_client);
+            } catch (const std::exception& e) {
+                std::cerr << "client " << i << ": " << e.what() << "\n";
+                std::exit(1);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long total = per_client * options.clients;
+
+    std::printf("commands      %ld\n", total);
+    std::printf("throughput    %.0f ops/s\n", total / seconds);
+    if (options.pid > 0) {
+        // Let per-client server threads exit so their counts are folded in.
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        double cpu_ms = (cpuTicks(options.pid) - cpu_before) * 1000.0 / sysconf(_SC_CLK_TCK);
+        std::printf("server cpu    %.0f ms (%.2f us/op)\n", cpu_ms, cpu_ms * 1000.0 / total);
+        if (!counters.empty()) {
+            uint64_t syscalls = 0;
+            for (int counter : counters) {
+                uint64_t count = 0;
+                if (read(counter, &count, sizeof(count)) == sizeof(count)) {
+                    syscalls += count;
+                }
+                close(counter);
+            }
+            std::printf("syscalls      %llu (%.3f per op)\n",
+                        static_cast<unsigned long long>(syscalls), static_cast<double>(syscalls) / total);
+        }
+    }
+    return 0;
+}
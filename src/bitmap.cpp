@@ -0,0 +1,158 @@
+#include "bitmap.hpp"
+#include "simd_kernels.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace bitmap {
+
+namespace {
+
+const uint8_t* bytes(const std::string& value) {
+    return reinterpret_cast<const uint8_t*>(value.data());
+}
+
+// Clamps a Redis-style [start, end] range to [0, len). Returns false if the
+// range is empty.
+bool normalizeRange(int64_t& start, int64_t& end, int64_t len) {
+    if (start < 0) start += len;
+    if (end < 0) end += len;
+    if (start < 0) start = 0;
+    if (end < 0) end = 0;
+    if (end >= len) end = len - 1;
+    return len > 0 && start <= end;
+}
+
+uint8_t bitAt(const uint8_t* data, uint64_t pos) {
+    return (data[pos >> 3] >> (7 - (pos & 7))) & 1;
+}
+
+} // namespace
+
+uint8_t getBit(const std::string& value, uint64_t offset) {
+    if ((offset >> 3) >= value.size()) {
+        return 0;
+    }
+    return bitAt(bytes(value), offset);
+}
+
+uint8_t setBit(std::string& value, uint64_t offset, bool on) {
+    size_t byte = static_cast<size_t>(offset >> 3);
+    if (byte >= value.size()) {
+        value.resize(byte + 1, '\0');
+    }
+    uint8_t mask = static_cast<uint8_t>(1 << (7 - (offset & 7)));
+    uint8_t current = static_cast<uint8_t>(value[byte]);
+    uint8_t old = (current & mask) ? 1 : 0;
+    value[byte] = static_cast<char>(on ? (current | mask) : (current & ~mask));
+    return old;
+}
+
+uint64_t count(const std::string& value, int64_t start, int64_t end, bool bit_unit) {
+    int64_t len = static_cast<int64_t>(value.size()) * (bit_unit ? 8 : 1);
+    if (!normalizeRange(start, end, len)) {
+        return 0;
+    }
+
+    const uint8_t* data = bytes(value);
+    if (!bit_unit) {
+        return simd::popcount(data + start, static_cast<size_t>(end - start + 1));
+    }
+
+    // Count whole bytes, then drop the bits outside the range at either end.
+    int64_t first = start >> 3;
+    int64_t last = end >> 3;
+    uint64_t total = simd::popcount(data + first, static_cast<size_t>(last - first + 1));
+    uint8_t head_mask = static_cast<uint8_t>(0xff << (8 - (start & 7)));
+    uint8_t tail_mask = static_cast<uint8_t>(0xff >> ((end & 7) + 1));
+    total -= __builtin_popcount(data[first] & head_mask);
+    total -= __builtin_popcount(data[last] & tail_mask);
+    return total;
+}
+
+int64_t position(const std::string& value, bool bit, int64_t start,
+                 std::optional<int64_t> end, bool bit_unit) {
+    if (value.empty()) {
+        return bit ? -1 : 0;
+    }
+
+    int64_t len = static_cast<int64_t>(value.size()) * (bit_unit ? 8 : 1);
+    int64_t range_end = end.value_or(len - 1);
+    if (!normalizeRange(start, range_end, len)) {
+        return -1;
+    }
+
+    uint64_t first = bit_unit ? static_cast<uint64_t>(start) : static_cast<uint64_t>(start) * 8;
+    uint64_t last = bit_unit ? static_cast<uint64_t>(range_end) : static_cast<uint64_t>(range_end) * 8 + 7;
+    const uint8_t* data = bytes(value);
+    const uint8_t skip = bit ? 0x00 : 0xff;
+    const uint64_t skip_word = bit ? 0 : ~uint64_t{0};
+
+    uint64_t pos = first;
+    while (pos <= last) {
+        // Skip whole words and bytes that cannot contain the bit.
+        if ((pos & 63) == 0 && pos + 63 <= last) {
+            uint64_t word;
+            std::memcpy(&word, data + (pos >> 3), 8);
+            if (word == skip_word) {
+                pos += 64;
+                continue;
+            }
+        }
+        if ((pos & 7) == 0 && pos + 7 <= last && data[pos >> 3] == skip) {
+            pos += 8;
+            continue;
+        }
+        if (bitAt(data, pos) == bit) {
+            return static_cast<int64_t>(pos);
+        }
+        ++pos;
+    }
+
+    if (!bit && !end) {
+        return static_cast<int64_t>(last + 1);
+    }
+    return -1;
+}
+
+std::string combine(Op op, const std::vector<std::optional<std::string>>& sources) {
+    if (sources.empty()) {
+        return {};
+    }
+
+    size_t max_len = 0;
+    for (const auto& src : sources) {
+        if (src) {
+            max_len = std::max(max_len, src->size());
+        }
+    }
+
+    if (op == Op::Not) {
+        std::string result = sources[0].value_or(std::string());
+        for (auto& c : result) {
+            c = static_cast<char>(~static_cast<uint8_t>(c));
+        }
+        return result;
+    }
+
+    // Zero-extend every source to the result length before combining.
+    std::string result = sources[0].value_or(std::string());
+    result.resize(max_len, '\0');
+    std::string padded;
+    simd::BitOp kernel_op = op == Op::And ? simd::BitOp::And
+                          : op == Op::Or  ? simd::BitOp::Or
+                                          : simd::BitOp::Xor;
+    uint8_t* dst = reinterpret_cast<uint8_t*>(result.data());
+
+    for (size_t i = 1; i < sources.size(); ++i) {
+        const std::string* src = sources[i] ? &*sources[i] : nullptr;
+        if (!src || src->size() < max_len) {
+            padded = src ? *src : std::string();
+            padded.resize(max_len, '\0');
+            src = &padded;
+        }
+        simd::bitop(kernel_op, dst, bytes(*src), max_len);
+    }
+    return result;
+}
+
+} // namespace bitmap
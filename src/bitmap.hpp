@@ -0,0 +1,37 @@
+#ifndef BITMAP_HPP
+#define BITMAP_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Bit-level operations on string values for SETBIT, GETBIT, BITCOUNT, BITOP
+// and BITPOS. Bit 0 is the most significant bit of the first byte, as in
+// Redis. Ranges follow Redis semantics: negative indexes count from the end
+// and are clamped to the value.
+namespace bitmap {
+
+enum class Op { And, Or, Xor, Not };
+
+uint8_t getBit(const std::string& value, uint64_t offset);
+
+// Grows value with zero bytes as needed; returns the previous bit.
+uint8_t setBit(std::string& value, uint64_t offset, bool on);
+
+// start/end are byte indexes, or bit indexes when bit_unit is set.
+uint64_t count(const std::string& value, int64_t start, int64_t end, bool bit_unit);
+
+// Returns the first position holding bit, or -1. When searching for a clear
+// bit without an explicit end, the value is treated as right-padded with
+// zeros, so the position just past the range is returned.
+int64_t position(const std::string& value, bool bit, int64_t start,
+                 std::optional<int64_t> end, bool bit_unit);
+
+// Missing sources (nullopt) act as zero-filled strings. The result is as
+// long as the longest source.
+std::string combine(Op op, const std::vector<std::optional<std::string>>& sources);
+
+} // namespace bitmap
+
+#endif // BITMAP_HPP
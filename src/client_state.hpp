@@ -0,0 +1,35 @@
+#ifndef CLIENT_STATE_HPP
+#define CLIENT_STATE_HPP
+
+#include "resp_parser.hpp"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Per-connection state owned by whichever I/O backend serves the client and
+// passed to CommandHandler with every command.
+struct ClientState {
+    uint64_t id = 0;            // Assigned by CommandHandler::onConnect
+    int protocol = 2;           // RESP version negotiated with HELLO
+    std::string name;
+    bool tracking = false;      // CLIENT TRACKING ON
+    bool tracking_bcast = false;
+
+    bool asking = false;        // ASKING: the next command may use an importing slot
+    bool event_loop = false;    // Served by the io_uring loop, which must never block
+
+    bool in_multi = false;
+    bool multi_aborted = false; // A command was rejected while queuing; EXEC fails
+    std::vector<RESPParser::Command> queued;
+    std::vector<std::pair<std::string, uint64_t>> watched;   // key -> version at WATCH time
+
+    void resetTransaction() {
+        in_multi = false;
+        multi_aborted = false;
+        queued.clear();
+        watched.clear();
+    }
+};
+
+#endif // CLIENT_STATE_HPP
@@ -0,0 +1,132 @@
+#include "client_tracking.hpp"
+#include "resp_parser.hpp"
+
+std::string ClientTracking::invalidateMessage(const std::string& key) {
+    return RESPParser::createPush({
+        RESPParser::createBulkString("invalidate"),
+        RESPParser::createArray({key}),
+    });
+}
+
+void ClientTracking::registerClient(uint64_t id, PushSink sink) {
+    std::lock_guard<std::mutex> lock(mutex);
+    sinks[id] = std::move(sink);
+}
+
+void ClientTracking::unregisterClient(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    sinks.erase(id);
+    enabled.erase(id);
+    enabled_count.store(enabled.size(), std::memory_order_release);
+    for (auto it = prefixes.begin(); it != prefixes.end();) {
+        it->second.erase(id);
+        it = it->second.empty() ? prefixes.erase(it) : std::next(it);
+    }
+    // Per-key reader entries are dropped lazily when the key is invalidated
+    // or evicted; unknown ids are skipped at delivery.
+}
+
+void ClientTracking::enable(uint64_t id, bool bcast, const std::vector<std::string>& prefix_list) {
+    std::lock_guard<std::mutex> lock(mutex);
+    enabled.insert(id);
+    enabled_count.store(enabled.size(), std::memory_order_release);
+    if (!bcast) {
+        return;
+    }
+    if (prefix_list.empty()) {
+        prefixes[""].insert(id);
+    }
+    for (const auto& prefix : prefix_list) {
+        prefixes[prefix].insert(id);
+    }
+}
+
+void ClientTracking::disable(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    enabled.erase(id);
+    enabled_count.store(enabled.size(), std::memory_order_release);
+    for (auto it = prefixes.begin(); it != prefixes.end();) {
+        it->second.erase(id);
+        it = it->second.empty() ? prefixes.erase(it) : std::next(it);
+    }
+}
+
+void ClientTracking::collect(const std::string& key, const std::unordered_set<uint64_t>& ids,
+                             std::vector<Delivery>& out) const {
+    std::string message;
+    for (uint64_t id : ids) {
+        if (!enabled.count(id)) {
+            continue;
+        }
+        auto sink = sinks.find(id);
+        if (sink == sinks.end()) {
+            continue;
+        }
+        if (message.empty()) {
+            message = invalidateMessage(key);
+        }
+        out.push_back({sink->second, message});
+    }
+}
+
+void ClientTracking::recordRead(uint64_t id, const std::string& key, size_t max_keys) {
+    std::lock_guard<std::mutex> lock(mutex);
+    readers[key].insert(id);
+
+    while (max_keys != 0 && readers.size() > max_keys) {
+        auto victim = readers.begin();
+        if (victim->first == key) {
+            victim = std::next(victim);
+        }
+        collect(victim->first, victim->second, evicted);
+        readers.erase(victim);
+    }
+    if (!evicted.empty()) {
+        evictions_pending.store(true, std::memory_order_release);
+    }
+}
+
+void ClientTracking::flushEvictions() {
+    if (!evictions_pending.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::vector<Delivery> deliveries;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        deliveries.swap(evicted);
+        evictions_pending.store(false, std::memory_order_relaxed);
+    }
+    // Sinks may block on a socket, so deliver outside the table lock.
+    for (const auto& d : deliveries) {
+        d.sink(d.message);
+    }
+}
+
+void ClientTracking::invalidate(const std::string& key) {
+    if (!active()) {
+        return;
+    }
+    std::vector<Delivery> deliveries;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unordered_set<uint64_t> ids;
+
+        auto it = readers.find(key);
+        if (it != readers.end()) {
+            ids = std::move(it->second);
+            readers.erase(it);
+        }
+        for (const auto& [prefix, clients] : prefixes) {
+            if (key.compare(0, prefix.size(), prefix) == 0) {
+                ids.insert(clients.begin(), clients.end());
+            }
+        }
+        if (ids.empty()) {
+            return;
+        }
+        collect(key, ids, deliveries);
+    }
+    for (const auto& d : deliveries) {
+        d.sink(d.message);
+    }
+}
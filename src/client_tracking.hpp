@@ -0,0 +1,64 @@
+#ifndef CLIENT_TRACKING_HPP
+#define CLIENT_TRACKING_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Server-assisted client-side caching. Remembers which clients read which
+// keys (or which key prefixes BCAST clients subscribed to) and pushes a
+// RESP3 "invalidate" message to them when one of those keys is written.
+class ClientTracking {
+public:
+    // Delivers an already encoded push message to one client. May be called
+    // from any thread that writes to the store, so it must only queue the
+    // message behind the client's pending replies, never send it directly.
+    using PushSink = std::function<void(const std::string&)>;
+
+    void registerClient(uint64_t id, PushSink sink);
+    void unregisterClient(uint64_t id);
+
+    void enable(uint64_t id, bool bcast, const std::vector<std::string>& prefixes);
+    void disable(uint64_t id);
+
+    // Remembers that client id may have cached key. Once more than max_keys
+    // keys are tracked (0 = unlimited), arbitrary keys are evicted, bounding
+    // the table's memory. Their readers are invalidated by the next
+    // flushEvictions(), since this may run with the store lock held.
+    void recordRead(uint64_t id, const std::string& key, size_t max_keys);
+    // Sends the invalidations queued by recordRead evictions. Call without
+    // the store lock.
+    void flushEvictions();
+
+    // Called after key was modified.
+    void invalidate(const std::string& key);
+
+    // Whether any client has tracking on; lets writers skip reporting keys.
+    bool active() const { return enabled_count.load(std::memory_order_acquire) != 0; }
+
+private:
+    struct Delivery {
+        PushSink sink;
+        std::string message;
+    };
+
+    std::unordered_map<uint64_t, PushSink> sinks;
+    std::unordered_set<uint64_t> enabled;
+    std::atomic<size_t> enabled_count{0};      // enabled.size(), readable without the mutex
+    std::unordered_map<std::string, std::unordered_set<uint64_t>> readers;   // key -> client ids
+    std::unordered_map<std::string, std::unordered_set<uint64_t>> prefixes;  // BCAST prefix -> client ids
+    std::vector<Delivery> evicted;             // Awaiting flushEvictions
+    std::atomic<bool> evictions_pending{false};
+    mutable std::mutex mutex;
+
+    void collect(const std::string& key, const std::unordered_set<uint64_t>& ids,
+                 std::vector<Delivery>& out) const;
+    static std::string invalidateMessage(const std::string& key);
+};
+
+#endif // CLIENT_TRACKING_HPP
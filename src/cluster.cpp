@@ -0,0 +1,485 @@
+#include "cluster.hpp"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::array<uint16_t, 256> makeCrc16Table() {
+    std::array<uint16_t, 256> table{};
+    for (int i = 0; i < 256; ++i) {
+        uint16_t crc = static_cast<uint16_t>(i << 8);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, 256> CRC16_TABLE = makeCrc16Table();
+
+uint16_t crc16(std::string_view data) {
+    uint16_t crc = 0;
+    for (unsigned char c : data) {
+        crc = static_cast<uint16_t>((crc << 8) ^ CRC16_TABLE[((crc >> 8) ^ c) & 0xff]);
+    }
+    return crc;
+}
+
+std::string generateNodeId() {
+    static const char HEX[] = "0123456789abcdef";
+    std::random_device device;
+    std::string id(40, '0');
+    for (auto& c : id) {
+        c = HEX[device() & 0xf];
+    }
+    return id;
+}
+
+long long parseNumber(const std::string& value, const char* what) {
+    try {
+        size_t used = 0;
+        long long parsed = std::stoll(value, &used);
+        if (used != value.size()) {
+            throw std::invalid_argument(what);
+        }
+        return parsed;
+    } catch (const std::exception&) {
+        throw std::invalid_argument(std::string("Invalid ") + what + " in gossip message");
+    }
+}
+
+void checkSlot(int slot) {
+    if (slot < 0 || slot >= ClusterState::SLOTS) {
+        throw std::invalid_argument("Invalid or out of range slot");
+    }
+}
+
+int64_t unixMillis(std::chrono::system_clock::time_point tp) {
+    if (tp == std::chrono::system_clock::time_point{}) {
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+
+std::string formatRanges(const std::vector<std::pair<int, int>>& ranges, char separator) {
+    std::string result;
+    for (const auto& [start, end] : ranges) {
+        if (!result.empty()) {
+            result += separator;
+        }
+        result += std::to_string(start);
+        if (end != start) {
+            result += "-" + std::to_string(end);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+int ClusterState::keyHashSlot(std::string_view key) {
+    size_t open = key.find('{');
+    if (open != std::string_view::npos) {
+        size_t close = key.find('}', open + 1);
+        if (close != std::string_view::npos && close != open + 1) {
+            key = key.substr(open + 1, close - open - 1);
+        }
+    }
+    return crc16(key) & (SLOTS - 1);
+}
+
+ClusterState::ClusterState(const ConfigManager& cfg)
+    : config(cfg), my_id(generateNodeId()), rng(std::random_device{}()) {}
+
+ClusterState::Address ClusterState::myAddress() const {
+    ConfigManager::Snapshot snapshot = config.snapshot();
+    return {snapshot->cluster_announce_ip, snapshot->port};
+}
+
+std::string ClusterState::addressOf(const std::string& id) const {
+    Address address = id == my_id ? myAddress() : nodes.at(id).address;
+    return address.ip + ":" + std::to_string(address.port);
+}
+
+uint64_t ClusterState::epochOf(const std::string& id) const {
+    return id == my_id ? my_epoch : nodes.at(id).config_epoch;
+}
+
+bool ClusterState::knownUnlocked(const std::string& id) const {
+    return id == my_id || nodes.count(id) > 0;
+}
+
+void ClusterState::bumpEpochUnlocked() {
+    my_epoch = ++current_epoch;
+}
+
+void ClusterState::forgetNodeUnlocked(const std::string& id) {
+    for (auto& owner : owners) {
+        if (owner == id) {
+            owner.clear();
+        }
+    }
+    std::erase_if(migrating_to, [&](const auto& entry) { return entry.second == id; });
+    std::erase_if(importing_from, [&](const auto& entry) { return entry.second == id; });
+    nodes.erase(id);
+}
+
+std::vector<std::pair<int, int>> ClusterState::rangesOf(const std::string& id) const {
+    std::vector<std::pair<int, int>> ranges;
+    for (int slot = 0; slot < SLOTS; ++slot) {
+        if (owners[slot] != id) {
+            continue;
+        }
+        if (!ranges.empty() && ranges.back().second == slot - 1) {
+            ranges.back().second = slot;
+        } else {
+            ranges.emplace_back(slot, slot);
+        }
+    }
+    return ranges;
+}
+
+ClusterState::SlotRoute ClusterState::route(int slot) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    SlotRoute result;
+    const std::string& owner = owners[slot];
+    result.mine = owner == my_id;
+    if (!result.mine && !owner.empty()) {
+        result.owner = addressOf(owner);
+    }
+    if (auto it = migrating_to.find(slot); it != migrating_to.end()) {
+        result.migrating_to = addressOf(it->second);
+    }
+    result.importing = importing_from.count(slot) > 0;
+    return result;
+}
+
+void ClusterState::addSlots(const std::vector<int>& slots) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    std::vector<bool> seen(SLOTS, false);
+    for (int slot : slots) {
+        checkSlot(slot);
+        if (!owners[slot].empty()) {
+            throw std::invalid_argument("Slot " + std::to_string(slot) + " is already busy");
+        }
+        if (seen[slot]) {
+            throw std::invalid_argument("Slot " + std::to_string(slot) + " specified multiple times");
+        }
+        seen[slot] = true;
+    }
+    for (int slot : slots) {
+        owners[slot] = my_id;
+        importing_from.erase(slot);
+    }
+}
+
+void ClusterState::delSlots(const std::vector<int>& slots) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    for (int slot : slots) {
+        checkSlot(slot);
+        if (owners[slot].empty()) {
+            throw std::invalid_argument("Slot " + std::to_string(slot) + " is already unassigned");
+        }
+    }
+    for (int slot : slots) {
+        owners[slot].clear();
+        migrating_to.erase(slot);
+        importing_from.erase(slot);
+    }
+}
+
+void ClusterState::setSlotMigrating(int slot, const std::string& node_id) {
+    checkSlot(slot);
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (owners[slot] != my_id) {
+        throw std::invalid_argument("I'm not the owner of hash slot " + std::to_string(slot));
+    }
+    if (node_id == my_id || !knownUnlocked(node_id)) {
+        throw std::invalid_argument("I don't know about node " + node_id);
+    }
+    migrating_to[slot] = node_id;
+}
+
+void ClusterState::setSlotImporting(int slot, const std::string& node_id) {
+    checkSlot(slot);
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (owners[slot] == my_id) {
+        throw std::invalid_argument("I'm already the owner of hash slot " + std::to_string(slot));
+    }
+    if (node_id == my_id || !knownUnlocked(node_id)) {
+        throw std::invalid_argument("I don't know about node " + node_id);
+    }
+    importing_from[slot] = node_id;
+}
+
+void ClusterState::setSlotStable(int slot) {
+    checkSlot(slot);
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    migrating_to.erase(slot);
+    importing_from.erase(slot);
+}
+
+void ClusterState::setSlotNode(int slot, const std::string& node_id) {
+    checkSlot(slot);
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (!knownUnlocked(node_id)) {
+        throw std::invalid_argument("Unknown node " + node_id);
+    }
+    if (node_id == my_id) {
+        // Taking over a slot needs an epoch above the previous owner's so
+        // that every peer accepts our claim through gossip.
+        if (!owners[slot].empty() && owners[slot] != my_id) {
+            bumpEpochUnlocked();
+        }
+        importing_from.erase(slot);
+    } else {
+        migrating_to.erase(slot);
+    }
+    owners[slot] = node_id;
+}
+
+void ClusterState::meet(const std::string& ip, int port) {
+    if (ip.empty() || port <= 0 || port > 65535) {
+        throw std::invalid_argument("Invalid node address specified: " + ip + ":" + std::to_string(port));
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    pending_meets.push_back({ip, port});
+}
+
+std::string ClusterState::nodesDescription() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto now = Clock::now();
+    auto timeout = std::chrono::milliseconds(config.snapshot()->cluster_node_timeout);
+
+    // Gossip shares the client port, so the bus port reported after '@'
+    // equals the client port.
+    auto line = [&](const std::string& id, const Address& address, const std::string& flags,
+                    int64_t ping_sent, int64_t pong_received, uint64_t epoch, bool connected) {
+        std::string port = std::to_string(address.port);
+        std::string result = id + " " + address.ip + ":" + port + "@" + port + " " + flags + " - " +
+                             std::to_string(ping_sent) + " " + std::to_string(pong_received) + " " +
+                             std::to_string(epoch) + " " + (connected ? "connected" : "disconnected");
+        std::string slots = formatRanges(rangesOf(id), ' ');
+        if (!slots.empty()) {
+            result += " " + slots;
+        }
+        return result;
+    };
+
+    std::string result = line(my_id, myAddress(), "myself,master", 0, 0, my_epoch, true);
+    for (const auto& [slot, target] : migrating_to) {
+        result += " [" + std::to_string(slot) + "->-" + target + "]";
+    }
+    for (const auto& [slot, source] : importing_from) {
+        result += " [" + std::to_string(slot) + "-<-" + source + "]";
+    }
+    result += "\n";
+
+    for (const auto& [id, node] : nodes) {
+        bool ever_seen = node.pong_received != Clock::time_point{};
+        bool connected = ever_seen && now - node.pong_received <= timeout;
+        std::string flags = ever_seen && !connected ? "master,fail?" : "master";
+        result += line(id, node.address, flags, unixMillis(node.ping_sent), unixMillis(node.pong_received),
+                       node.config_epoch, connected) + "\n";
+    }
+    return result;
+}
+
+std::vector<ClusterState::SlotRange> ClusterState::slotRanges() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::vector<SlotRange> ranges;
+    for (int slot = 0; slot < SLOTS; ++slot) {
+        const std::string& owner = owners[slot];
+        if (owner.empty()) {
+            continue;
+        }
+        if (!ranges.empty() && ranges.back().end == slot - 1 && ranges.back().id == owner) {
+            ranges.back().end = slot;
+            continue;
+        }
+        Address address = owner == my_id ? myAddress() : nodes.at(owner).address;
+        ranges.push_back({slot, slot, owner, std::move(address)});
+    }
+    return ranges;
+}
+
+std::string ClusterState::info() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto now = Clock::now();
+    auto timeout = std::chrono::milliseconds(config.snapshot()->cluster_node_timeout);
+
+    int assigned = 0;
+    int pfail = 0;
+    std::vector<std::string> owners_seen;
+    for (const auto& owner : owners) {
+        if (owner.empty()) {
+            continue;
+        }
+        ++assigned;
+        if (owner != my_id && now - nodes.at(owner).pong_received > timeout) {
+            ++pfail;
+        }
+        if (std::find(owners_seen.begin(), owners_seen.end(), owner) == owners_seen.end()) {
+            owners_seen.push_back(owner);
+        }
+    }
+
+    return "cluster_enabled:1\r\n"
+           "cluster_state:" + std::string(assigned == SLOTS ? "ok" : "fail") + "\r\n"
+           "cluster_slots_assigned:" + std::to_string(assigned) + "\r\n"
+           "cluster_slots_ok:" + std::to_string(assigned - pfail) + "\r\n"
+           "cluster_slots_pfail:" + std::to_string(pfail) + "\r\n"
+           "cluster_slots_fail:0\r\n"
+           "cluster_known_nodes:" + std::to_string(nodes.size() + 1) + "\r\n"
+           "cluster_size:" + std::to_string(owners_seen.size()) + "\r\n"
+           "cluster_current_epoch:" + std::to_string(current_epoch) + "\r\n"
+           "cluster_my_epoch:" + std::to_string(my_epoch) + "\r\n";
+}
+
+std::vector<std::string> ClusterState::gossipMessage() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    Address me = myAddress();
+    std::string slots = formatRanges(rangesOf(my_id), ',');
+    std::vector<std::string> fields = {my_id, me.ip, std::to_string(me.port), std::to_string(my_epoch),
+                                       slots.empty() ? "-" : slots};
+    fields.reserve(fields.size() + nodes.size() * 4);
+    for (const auto& [id, node] : nodes) {
+        fields.push_back(id);
+        fields.push_back(node.address.ip);
+        fields.push_back(std::to_string(node.address.port));
+        fields.push_back(std::to_string(node.config_epoch));
+    }
+    return fields;
+}
+
+void ClusterState::handleGossip(const std::vector<std::string>& fields) {
+    // <id> <ip> <port> <epoch> <slot ranges or "-"> followed by
+    // <id> <ip> <port> <epoch> for every peer the sender knows.
+    if (fields.size() < 5 || (fields.size() - 5) % 4 != 0) {
+        throw std::invalid_argument("Malformed gossip message");
+    }
+    const std::string& id = fields[0];
+    Address address{fields[1], static_cast<int>(parseNumber(fields[2], "port"))};
+    uint64_t epoch = static_cast<uint64_t>(parseNumber(fields[3], "epoch"));
+
+    std::vector<bool> claimed(SLOTS, false);
+    if (fields[4] != "-") {
+        size_t pos = 0;
+        while (pos <= fields[4].size()) {
+            size_t comma = std::min(fields[4].find(',', pos), fields[4].size());
+            std::string range = fields[4].substr(pos, comma - pos);
+            size_t dash = range.find('-');
+            long long start = parseNumber(range.substr(0, dash), "slot");
+            long long end = dash == std::string::npos ? start : parseNumber(range.substr(dash + 1), "slot");
+            if (start < 0 || end >= SLOTS || start > end) {
+                throw std::invalid_argument("Invalid slot range in gossip message");
+            }
+            std::fill(claimed.begin() + start, claimed.begin() + end + 1, true);
+            pos = comma + 1;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (id == my_id) {
+        return;
+    }
+
+    auto sameAddress = [](const Address& a, const Address& b) { return a.ip == b.ip && a.port == b.port; };
+    auto idsAt = [&](const Address& at, const std::string& except) {
+        std::vector<std::string> ids;
+        for (const auto& [node_id, node] : nodes) {
+            if (node_id != except && sameAddress(node.address, at)) {
+                ids.push_back(node_id);
+            }
+        }
+        return ids;
+    };
+
+    // A node restarted at a known address comes back with a new id; drop the
+    // stale entry and the slots it held.
+    for (const auto& stale : idsAt(address, id)) {
+        forgetNodeUnlocked(stale);
+    }
+
+    Node& node = nodes[id];
+    node.id = id;
+    node.address = address;
+    node.config_epoch = epoch;
+    node.pong_received = Clock::now();
+    current_epoch = std::max(current_epoch, epoch);
+
+    for (int slot = 0; slot < SLOTS; ++slot) {
+        std::string& owner = owners[slot];
+        if (claimed[slot]) {
+            if (owner != id && (owner.empty() || epochOf(owner) < epoch)) {
+                if (owner == my_id) {
+                    migrating_to.erase(slot);
+                }
+                owner = id;
+            }
+        } else if (owner == id) {
+            owner.clear();
+        }
+    }
+
+    // Two nodes must never share an epoch, or a slot both claim could never
+    // be settled; the node with the greater id moves on.
+    if (epoch == my_epoch && id < my_id) {
+        bumpEpochUnlocked();
+    }
+
+    // Second-hand entries may name an id that restarted since: never one at
+    // our own or the sender's address, and they replace a node at the same
+    // address only once that node has missed the node timeout, so a stale
+    // view cannot evict an id we hear from directly.
+    Address me = myAddress();
+    auto timeout = std::chrono::milliseconds(config.snapshot()->cluster_node_timeout);
+    auto now = Clock::now();
+    for (size_t i = 5; i + 3 < fields.size(); i += 4) {
+        const std::string& peer_id = fields[i];
+        Address peer_address{fields[i + 1], static_cast<int>(parseNumber(fields[i + 2], "port"))};
+        uint64_t peer_epoch = static_cast<uint64_t>(parseNumber(fields[i + 3], "epoch"));
+        if (knownUnlocked(peer_id) || sameAddress(peer_address, me) || sameAddress(peer_address, address)) {
+            continue;
+        }
+        std::vector<std::string> others = idsAt(peer_address, peer_id);
+        bool live = std::any_of(others.begin(), others.end(), [&](const std::string& other) {
+            return now - nodes.at(other).pong_received <= timeout;
+        });
+        if (live) {
+            continue;
+        }
+        for (const auto& stale : others) {
+            forgetNodeUnlocked(stale);
+        }
+        Node peer;
+        peer.id = peer_id;
+        peer.address = peer_address;
+        peer.config_epoch = peer_epoch;
+        nodes.emplace(peer_id, std::move(peer));
+    }
+}
+
+std::vector<ClusterState::Address> ClusterState::gossipTargets() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    std::vector<Address> targets = std::move(pending_meets);
+    pending_meets.clear();
+    if (nodes.empty()) {
+        return targets;
+    }
+
+    auto now = Clock::now();
+    auto half_timeout = std::chrono::milliseconds(config.snapshot()->cluster_node_timeout) / 2;
+    auto random = std::next(nodes.begin(), static_cast<long>(rng() % nodes.size()));
+    for (auto it = nodes.begin(); it != nodes.end(); ++it) {
+        Node& node = it->second;
+        bool stale = now - node.pong_received > half_timeout && now - node.ping_sent > half_timeout;
+        if (it == random || stale) {
+            node.ping_sent = now;
+            targets.push_back(node.address);
+        }
+    }
+    return targets;
+}
@@ -0,0 +1,112 @@
+#ifndef CLUSTER_HPP
+#define CLUSTER_HPP
+
+#include "config_manager.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// This node's view of a hash-slot cluster: which node serves each of the
+// 16384 slots, which slots are being migrated, and the known peers. Peers
+// exchange their view with CLUSTER GOSSIP messages over the normal client
+// port; conflicting slot claims are settled by the higher config epoch.
+// Methods that change the table throw std::invalid_argument on bad input.
+class ClusterState {
+public:
+    static constexpr int SLOTS = 16384;
+
+    // CRC16 (XMODEM) of key, or of the first non-empty "{...}" section in it,
+    // modulo SLOTS.
+    static int keyHashSlot(std::string_view key);
+
+    struct Address {
+        std::string ip;
+        int port = 0;
+    };
+
+    // Where a slot is served from, as seen by this node. Addresses are
+    // "ip:port" and empty when not applicable.
+    struct SlotRoute {
+        bool mine = false;
+        std::string owner;
+        std::string migrating_to;
+        bool importing = false;
+    };
+
+    struct SlotRange {
+        int start;
+        int end;
+        std::string id;
+        Address address;
+    };
+
+    explicit ClusterState(const ConfigManager& config);
+
+    const std::string& myId() const { return my_id; }
+
+    SlotRoute route(int slot) const;
+
+    void addSlots(const std::vector<int>& slots);
+    void delSlots(const std::vector<int>& slots);
+    void setSlotMigrating(int slot, const std::string& node_id);
+    void setSlotImporting(int slot, const std::string& node_id);
+    void setSlotStable(int slot);
+    void setSlotNode(int slot, const std::string& node_id);
+    // Queues a handshake with ip:port for the next gossip round.
+    void meet(const std::string& ip, int port);
+
+    std::string nodesDescription() const;
+    std::vector<SlotRange> slotRanges() const;
+    std::string info() const;
+
+    // Fields of a CLUSTER GOSSIP message describing this node and its peers.
+    std::vector<std::string> gossipMessage() const;
+    // Merges a gossip message received from, or as a reply from, a peer.
+    void handleGossip(const std::vector<std::string>& fields);
+    // Peers to gossip with now: pending MEETs, one random peer and any peer
+    // not heard from for half the node timeout.
+    std::vector<Address> gossipTargets();
+
+private:
+    using Clock = std::chrono::system_clock;
+
+    struct Node {
+        std::string id;
+        Address address;
+        uint64_t config_epoch = 0;
+        Clock::time_point pong_received{};   // Epoch start until first contact
+        Clock::time_point ping_sent{};
+    };
+
+    const ConfigManager& config;
+    std::string my_id;
+    uint64_t my_epoch = 0;
+    uint64_t current_epoch = 0;
+    std::unordered_map<std::string, Node> nodes;   // Peers only, keyed by id
+    std::array<std::string, SLOTS> owners;         // Node id per slot, empty if unassigned
+    std::unordered_map<int, std::string> migrating_to;
+    std::unordered_map<int, std::string> importing_from;
+    std::vector<Address> pending_meets;
+    std::mt19937_64 rng;
+    mutable std::shared_mutex mutex;
+
+    Address myAddress() const;
+    // Callers must hold mutex.
+    std::string addressOf(const std::string& id) const;
+    uint64_t epochOf(const std::string& id) const;
+    bool knownUnlocked(const std::string& id) const;
+    void bumpEpochUnlocked();
+    // Drops a peer together with the slots it held and any migration to or
+    // from it.
+    void forgetNodeUnlocked(const std::string& id);
+    std::vector<std::pair<int, int>> rangesOf(const std::string& id) const;
+};
+
+#endif // CLUSTER_HPP
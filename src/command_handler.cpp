@@ -1,20 +1,666 @@
 #include "command_handler.hpp"
 #include "rdb_reader.hpp"
+#include "glob_matcher.hpp"
+#include "bitmap.hpp"
+#include "hyperloglog.hpp"
+#include "resp_client.hpp"
 #include <algorithm>
+#include <charconv>
 #include <stdexcept>
+#include <unordered_map>
 #include <iostream>
 
-CommandHandler::CommandHandler(KeyValueStore& store, ConfigManager& cfg) 
-    : kv_store(store), config_manager(cfg) {}
+CommandHandler::CommandHandler(KeyValueStore& store, ConfigManager& cfg, ClientTracking& tracking,
+                               ClusterState& cluster) 
+    : kv_store(store), config_manager(cfg), client_tracking(tracking), cluster_state(cluster) {}
+
+void CommandHandler::onConnect(ClientState& client, ClientTracking::PushSink push) {
+    client.id = next_client_id.fetch_add(1, std::memory_order_relaxed);
+    client_tracking.registerClient(client.id, std::move(push));
+}
+
+void CommandHandler::onDisconnect(ClientState& client) {
+    client_tracking.unregisterClient(client.id);
+}
+
+namespace {
+
+// Runs fn against a transaction on store. Inside EXEC the store already is a
+// transaction, so read-modify-write commands never take the lock twice.
+template <typename Fn>
+auto atomically(KeyValueStore& store, Fn&& fn) {
+    KeyValueStore::Transaction tx = store.transaction();
+    return fn(tx);
+}
+
+template <typename Fn>
+auto atomically(KeyValueStore::Transaction& tx, Fn&& fn) {
+    return fn(tx);
+}
+
+const char* const HLL_WRONGTYPE = "WRONGTYPE Key is not a valid HyperLogLog string value.";
+const char* const NOT_AN_INTEGER = "ERR value is not an integer or out of range";
+const char* const SYNTAX_ERROR = "ERR syntax error";
+
+HyperLogLog loadHyperLogLog(KeyValueStore::Transaction& tx, const std::string& key, bool& exists) {
+    auto value = tx.get(key);
+    exists = value.has_value();
+    if (!value) {
+        return HyperLogLog();
+    }
+    auto hll = HyperLogLog::parse(*value);
+    if (!hll) {
+        throw CommandError(HLL_WRONGTYPE);
+    }
+    return std::move(*hll);
+}
+
+// Arity of every command executeCommand serves, counting the command name;
+// negative values are minimums. Used to reject commands while queuing a
+// MULTI block.
+const std::unordered_map<std::string, int> COMMAND_ARITY = {
+    {"PING", -1},    {"HELLO", -1},    {"CLIENT", -2},   {"ECHO", 2},
+    {"CONFIG", -2},  {"SET", -3},      {"GET", 2},       {"SETBIT", 4},
+    {"GETBIT", 3},   {"BITCOUNT", -2}, {"BITPOS", -3},   {"BITOP", -4},
+    {"PFADD", -2},   {"PFCOUNT", -2},  {"PFMERGE", -2},  {"DUMP", 2},
+    {"RESTORE", -4}, {"RESTORE-ASKING", -4},             {"KEYS", 2},
+};
+
+std::optional<std::string> arityError(const RESPParser::Command& cmd) {
+    auto it = COMMAND_ARITY.find(cmd.name);
+    if (it == COMMAND_ARITY.end()) {
+        return "ERR unknown command '" + cmd.name + "'";
+    }
+    int arity = it->second;
+    int given = static_cast<int>(cmd.args.size()) + 1;
+    if ((arity > 0 && given != arity) || (arity < 0 && given < -arity)) {
+        std::string name = cmd.name;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        return "ERR wrong number of arguments for '" + name + "' command";
+    }
+    return std::nullopt;
+}
+
+// Arguments of cmd that name keys, for cluster slot routing.
+std::vector<const std::string*> commandKeys(const RESPParser::Command& cmd) {
+    std::vector<const std::string*> keys;
+    const std::string& name = cmd.name;
+    size_t first = 0;
+    size_t last = 0;   // Exclusive
+    if (name == "GET" || name == "SET" || name == "SETBIT" || name == "GETBIT" || name == "BITCOUNT" ||
+        name == "BITPOS" || name == "PFADD" || name == "DUMP" || name == "RESTORE" || name == "RESTORE-ASKING") {
+        last = std::min<size_t>(1, cmd.args.size());
+    } else if (name == "PFCOUNT" || name == "PFMERGE" || name == "WATCH") {
+        last = cmd.args.size();
+    } else if (name == "BITOP") {
+        first = 1;
+        last = cmd.args.size();
+    }
+    for (size_t i = first; i < last; ++i) {
+        keys.push_back(&cmd.args[i]);
+    }
+    return keys;
+}
+
+int parseSlot(const std::string& arg) {
+    int slot = 0;
+    auto [ptr, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), slot);
+    if (ec != std::errc() || ptr != arg.data() + arg.size() || slot < 0 || slot >= ClusterState::SLOTS) {
+        throw CommandError("ERR Invalid or out of range slot");
+    }
+    return slot;
+}
+
+// Parses the optional trailing BYTE|BIT unit of BITCOUNT/BITPOS.
+bool parseBitUnit(const std::string& arg) {
+    std::string unit = arg;
+    std::transform(unit.begin(), unit.end(), unit.begin(), ::toupper);
+    if (unit == "BIT") return true;
+    if (unit == "BYTE") return false;
+    throw CommandError(SYNTAX_ERROR);
+}
+
+} // namespace
 
 bool CommandHandler::isNumber(const std::string& s) {
     return !s.empty() && std::all_of(s.begin(), s.end(), ::isdigit);
 }
 
-std::string CommandHandler::handleCommand(const RESPParser::Command& cmd) {
+std::optional<int64_t> CommandHandler::parseInteger(const std::string& s) {
+    int64_t value = 0;
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (ec != std::errc() || ptr != s.data() + s.size() || s.empty()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+// Called before the key is read, so a write that races with the read still
+// finds this client in the tracking table and invalidates it.
+void CommandHandler::trackRead(const ClientState& client, const std::string& key) {
+    if (client.tracking && !client.tracking_bcast) {
+        client_tracking.recordRead(client.id, key, config_manager.snapshot()->tracking_table_max_keys);
+    }
+}
+
+std::string CommandHandler::handleHello(const RESPParser::Command& cmd, ClientState& client) {
+    int protocol = client.protocol;
+    size_t i = 0;
+    if (!cmd.args.empty()) {
+        auto version = parseInteger(cmd.args[0]);
+        if (!version) {
+            throw CommandError("ERR Protocol version is not an integer or out of range");
+        }
+        if (*version != 2 && *version != 3) {
+            throw CommandError("NOPROTO unsupported protocol version");
+        }
+        protocol = static_cast<int>(*version);
+        i = 1;
+    }
+
+    std::string name = client.name;
+    for (; i < cmd.args.size(); ++i) {
+        std::string option = cmd.args[i];
+        std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+        if (option == "SETNAME" && i + 1 < cmd.args.size()) {
+            name = cmd.args[++i];
+        } else if (option == "AUTH") {
+            throw CommandError("ERR AUTH is not supported by this server");
+        } else {
+            throw CommandError("ERR Syntax error in HELLO option '" + cmd.args[i] + "'");
+        }
+    }
+
+    if (protocol == 2 && client.tracking) {
+        // Invalidations are RESP3 pushes, which a RESP2 client cannot parse.
+        client_tracking.disable(client.id);
+        client.tracking = false;
+        client.tracking_bcast = false;
+    }
+    client.protocol = protocol;
+    client.name = name;
+    return RESPParser::createMap({
+        {"server", RESPParser::createBulkString("redis")},
+        {"version", RESPParser::createBulkString("7.0.0")},
+        {"proto", RESPParser::createInteger(protocol)},
+        {"id", RESPParser::createInteger(static_cast<long long>(client.id))},
+        {"mode", RESPParser::createBulkString(config_manager.snapshot()->cluster_enabled ? "cluster" : "standalone")},
+        {"role", RESPParser::createBulkString("master")},
+        {"modules", RESPParser::createArray({})},
+    }, protocol);
+}
+
+std::string CommandHandler::handleClientCommand(const RESPParser::Command& cmd, ClientState& client) {
+    if (cmd.args.empty()) {
+        throw CommandError("ERR wrong number of arguments for 'client' command");
+    }
+    std::string subcommand = cmd.args[0];
+    std::transform(subcommand.begin(), subcommand.end(), subcommand.begin(), ::toupper);
+
+    if (subcommand == "ID") {
+        return RESPParser::createInteger(static_cast<long long>(client.id));
+    }
+    if (subcommand == "SETNAME" && cmd.args.size() == 2) {
+        client.name = cmd.args[1];
+        return RESPParser::createSimpleString("OK");
+    }
+    if (subcommand == "GETNAME") {
+        return client.name.empty() ? RESPParser::createNullBulkString()
+                                   : RESPParser::createBulkString(client.name);
+    }
+    if (subcommand != "TRACKING" || cmd.args.size() < 2) {
+        throw CommandError("ERR unknown subcommand or wrong number of arguments for 'client|" +
+                           cmd.args[0] + "'");
+    }
+
+    std::string mode = cmd.args[1];
+    std::transform(mode.begin(), mode.end(), mode.begin(), ::toupper);
+    if (mode == "OFF") {
+        client_tracking.disable(client.id);
+        client.tracking = false;
+        client.tracking_bcast = false;
+        return RESPParser::createSimpleString("OK");
+    }
+    if (mode != "ON") {
+        throw CommandError(SYNTAX_ERROR);
+    }
+
+    bool bcast = false;
+    std::vector<std::string> prefixes;
+    for (size_t i = 2; i < cmd.args.size(); ++i) {
+        std::string option = cmd.args[i];
+        std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+        if (option == "BCAST") {
+            bcast = true;
+        } else if (option == "PREFIX" && i + 1 < cmd.args.size()) {
+            prefixes.push_back(cmd.args[++i]);
+        } else {
+            throw CommandError(SYNTAX_ERROR);
+        }
+    }
+    if (!prefixes.empty() && !bcast) {
+        throw CommandError("ERR PREFIX option requires BCAST mode to be enabled");
+    }
+    if (client.protocol < 3) {
+        // Invalidations are delivered as RESP3 pushes on the same connection;
+        // RESP2 would need REDIRECT to a Pub/Sub connection.
+        throw CommandError("ERR Client tracking requires RESP3, switch with HELLO 3");
+    }
+
+    // Re-enabling replaces any previous mode and prefixes.
+    client_tracking.disable(client.id);
+    client_tracking.enable(client.id, bcast, prefixes);
+    client.tracking = true;
+    client.tracking_bcast = bcast;
+    return RESPParser::createSimpleString("OK");
+}
+
+std::optional<std::string> CommandHandler::clusterRedirect(const RESPParser::Command& cmd, bool asking) {
+    std::vector<const std::string*> keys = commandKeys(cmd);
+    if (keys.empty()) {
+        return std::nullopt;
+    }
+    int slot = ClusterState::keyHashSlot(*keys[0]);
+    for (size_t i = 1; i < keys.size(); ++i) {
+        if (ClusterState::keyHashSlot(*keys[i]) != slot) {
+            return "CROSSSLOT Keys in request don't hash to the same slot";
+        }
+    }
+
+    ClusterState::SlotRoute route = cluster_state.route(slot);
+    if (route.mine) {
+        if (route.migrating_to.empty()) {
+            return std::nullopt;
+        }
+        // Keys already moved to the target are served there; a request
+        // touching both moved and unmoved keys has to wait for the migration.
+        size_t missing = std::count_if(keys.begin(), keys.end(), [&](const std::string* key) {
+            return !kv_store.exists(*key);
+        });
+        if (missing == 0) {
+            return std::nullopt;
+        }
+        if (missing == keys.size()) {
+            return "ASK " + std::to_string(slot) + " " + route.migrating_to;
+        }
+        return "TRYAGAIN Multiple keys request during rehashing of slot";
+    }
+    if (route.importing && (asking || cmd.name == "RESTORE-ASKING")) {
+        return std::nullopt;
+    }
+    if (route.owner.empty()) {
+        return "CLUSTERDOWN Hash slot not served";
+    }
+    return "MOVED " + std::to_string(slot) + " " + route.owner;
+}
+
+std::string CommandHandler::handleClusterCommand(const RESPParser::Command& cmd) {
+    if (!config_manager.snapshot()->cluster_enabled) {
+        throw CommandError("ERR This instance has cluster support disabled");
+    }
+    if (cmd.args.empty()) {
+        throw CommandError("ERR wrong number of arguments for 'cluster' command");
+    }
+    std::string subcommand = cmd.args[0];
+    std::transform(subcommand.begin(), subcommand.end(), subcommand.begin(), ::toupper);
+
+    try {
+        if (subcommand == "KEYSLOT" && cmd.args.size() == 2) {
+            return RESPParser::createInteger(ClusterState::keyHashSlot(cmd.args[1]));
+        }
+        if (subcommand == "MYID" && cmd.args.size() == 1) {
+            return RESPParser::createBulkString(cluster_state.myId());
+        }
+        if (subcommand == "NODES" && cmd.args.size() == 1) {
+            return RESPParser::createBulkString(cluster_state.nodesDescription());
+        }
+        if (subcommand == "INFO" && cmd.args.size() == 1) {
+            return RESPParser::createBulkString(cluster_state.info());
+        }
+        if (subcommand == "SLOTS" && cmd.args.size() == 1) {
+            std::vector<std::string> ranges;
+            for (const auto& range : cluster_state.slotRanges()) {
+                ranges.push_back(RESPParser::createEncodedArray({
+                    RESPParser::createInteger(range.start),
+                    RESPParser::createInteger(range.end),
+                    RESPParser::createEncodedArray({
+                        RESPParser::createBulkString(range.address.ip),
+                        RESPParser::createInteger(range.address.port),
+                        RESPParser::createBulkString(range.id),
+                    }),
+                }));
+            }
+            return RESPParser::createEncodedArray(ranges);
+        }
+        if (subcommand == "MEET" && cmd.args.size() == 3) {
+            auto port = parseInteger(cmd.args[2]);
+            if (!port) {
+                throw CommandError("ERR Invalid base port specified: " + cmd.args[2]);
+            }
+            cluster_state.meet(cmd.args[1], static_cast<int>(*port));
+            return RESPParser::createSimpleString("OK");
+        }
+        if ((subcommand == "ADDSLOTS" || subcommand == "DELSLOTS") && cmd.args.size() >= 2) {
+            std::vector<int> slots;
+            for (size_t i = 1; i < cmd.args.size(); ++i) {
+                slots.push_back(parseSlot(cmd.args[i]));
+            }
+            if (subcommand == "ADDSLOTS") {
+                cluster_state.addSlots(slots);
+            } else {
+                cluster_state.delSlots(slots);
+            }
+            return RESPParser::createSimpleString("OK");
+        }
+        if (subcommand == "ADDSLOTSRANGE" && cmd.args.size() >= 3 && cmd.args.size() % 2 == 1) {
+            std::vector<int> slots;
+            for (size_t i = 1; i + 1 < cmd.args.size(); i += 2) {
+                int start = parseSlot(cmd.args[i]);
+                int end = parseSlot(cmd.args[i + 1]);
+                if (start > end) {
+                    throw CommandError("ERR start slot number " + cmd.args[i] +
+                                       " is greater than end slot number " + cmd.args[i + 1]);
+                }
+                for (int slot = start; slot <= end; ++slot) {
+                    slots.push_back(slot);
+                }
+            }
+            cluster_state.addSlots(slots);
+            return RESPParser::createSimpleString("OK");
+        }
+        if (subcommand == "SETSLOT" && cmd.args.size() >= 3) {
+            int slot = parseSlot(cmd.args[1]);
+            std::string action = cmd.args[2];
+            std::transform(action.begin(), action.end(), action.begin(), ::toupper);
+            if (action == "STABLE" && cmd.args.size() == 3) {
+                cluster_state.setSlotStable(slot);
+            } else if (action == "MIGRATING" && cmd.args.size() == 4) {
+                cluster_state.setSlotMigrating(slot, cmd.args[3]);
+            } else if (action == "IMPORTING" && cmd.args.size() == 4) {
+                cluster_state.setSlotImporting(slot, cmd.args[3]);
+            } else if (action == "NODE" && cmd.args.size() == 4) {
+                if (cmd.args[3] != cluster_state.myId() && cluster_state.route(slot).mine &&
+                    !kv_store.getKeysInSlot(slot, 1).empty()) {
+                    throw CommandError("ERR Can't assign hashslot " + std::to_string(slot) +
+                                       " to a different node while I still hold keys for this hash slot.");
+                }
+                cluster_state.setSlotNode(slot, cmd.args[3]);
+            } else {
+                throw CommandError(SYNTAX_ERROR);
+            }
+            return RESPParser::createSimpleString("OK");
+        }
+        if (subcommand == "COUNTKEYSINSLOT" && cmd.args.size() == 2) {
+            int slot = parseSlot(cmd.args[1]);
+            return RESPParser::createInteger(static_cast<long long>(kv_store.countKeysInSlot(slot)));
+        }
+        if (subcommand == "GETKEYSINSLOT" && cmd.args.size() == 3) {
+            int slot = parseSlot(cmd.args[1]);
+            auto count = parseInteger(cmd.args[2]);
+            if (!count || *count < 0) {
+                throw CommandError("ERR Invalid number of keys");
+            }
+            return RESPParser::createArray(kv_store.getKeysInSlot(slot, static_cast<size_t>(*count)));
+        }
+        if (subcommand == "GOSSIP" && cmd.args.size() >= 2) {
+            cluster_state.handleGossip(std::vector<std::string>(cmd.args.begin() + 1, cmd.args.end()));
+            return RESPParser::createArray(cluster_state.gossipMessage());
+        }
+    } catch (const std::invalid_argument& e) {
+        throw CommandError("ERR " + std::string(e.what()));
+    }
+    throw CommandError("ERR unknown subcommand or wrong number of arguments for 'cluster|" + cmd.args[0] + "'");
+}
+
+std::string CommandHandler::handleMigrate(const RESPParser::Command& cmd) {
+    // MIGRATE host port key|"" destination-db timeout [COPY] [REPLACE] [KEYS key ...]
+    if (cmd.args.size() < 5) {
+        throw CommandError("ERR wrong number of arguments for 'migrate' command");
+    }
+    auto port = parseInteger(cmd.args[1]);
+    auto db = parseInteger(cmd.args[3]);
+    auto timeout = parseInteger(cmd.args[4]);
+    if (!port || !db || !timeout || *port <= 0 || *port > 65535 || *timeout < 0) {
+        throw CommandError(NOT_AN_INTEGER);
+    }
+    if (*db != 0) {
+        throw CommandError("ERR DB index is out of range");
+    }
+
+    bool copy = false;
+    bool replace = false;
+    std::vector<std::string> keys;
+    for (size_t i = 5; i < cmd.args.size(); ++i) {
+        std::string option = cmd.args[i];
+        std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+        if (option == "COPY") {
+            copy = true;
+        } else if (option == "REPLACE") {
+            replace = true;
+        } else if (option == "KEYS") {
+            if (!cmd.args[2].empty()) {
+                throw CommandError("ERR When using MIGRATE KEYS option, the key argument must be set to the empty string");
+            }
+            keys.assign(cmd.args.begin() + static_cast<long>(i) + 1, cmd.args.end());
+            break;
+        } else {
+            throw CommandError(SYNTAX_ERROR);
+        }
+    }
+    if (keys.empty() && !cmd.args[2].empty()) {
+        keys.push_back(cmd.args[2]);
+    }
+
+    struct Item {
+        std::string key;
+        std::string value;
+        std::optional<std::chrono::milliseconds> ttl;
+        uint64_t version;
+    };
+    std::vector<Item> items;
+    {
+        KeyValueStore::Transaction tx = kv_store.transaction();
+        for (const auto& key : keys) {
+            if (auto value = tx.get(key)) {
+                items.push_back({key, std::move(*value), tx.ttl(key), tx.version(key)});
+            }
+        }
+    }
+    if (items.empty()) {
+        return RESPParser::createSimpleString("NOKEY");
+    }
+
+    // The store lock is not held while talking to the target, so writes to
+    // the keys meanwhile win: a key is only removed if it is unchanged.
+    std::vector<std::vector<std::string>> requests;
+    for (const auto& item : items) {
+        std::vector<std::string> request = {"RESTORE-ASKING", item.key,
+                                            std::to_string(item.ttl ? item.ttl->count() : 0), item.value};
+        if (replace) {
+            request.push_back("REPLACE");
+        }
+        requests.push_back(std::move(request));
+    }
+    std::vector<RESPClient::Reply> replies;
+    try {
+        RESPClient target(cmd.args[0], static_cast<int>(*port),
+                          std::chrono::milliseconds(*timeout > 0 ? *timeout : 1000));
+        replies = target.callPipelined(requests);
+    } catch (const std::exception&) {
+        return RESPParser::createError("IOERR error or timeout reading to target instance");
+    }
+
+    std::optional<std::string> error;
+    {
+        KeyValueStore::Transaction tx = kv_store.transaction();
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (replies[i].isError()) {
+                if (!error) {
+                    error = "ERR Target instance replied with error: " + replies[i].str;
+                }
+            } else if (!copy && tx.version(items[i].key) == items[i].version) {
+                tx.remove(items[i].key);
+            }
+        }
+    }
+    return error ? RESPParser::createError(*error) : RESPParser::createSimpleString("OK");
+}
+
+void CommandHandler::checkMaxMemory() const {
+    uint64_t maxmemory = config_manager.snapshot()->maxmemory;
+    if (maxmemory != 0 && kv_store.usedMemory() >= maxmemory) {
+        throw CommandError("OOM command not allowed when used memory > 'maxmemory'.");
+    }
+}
+
+std::string CommandHandler::handleCommand(const RESPParser::Command& cmd, ClientState& client) {
+    // ASKING only covers the command right after it.
+    bool asking = client.asking;
+    client.asking = false;
+
+    bool cluster_enabled = config_manager.snapshot()->cluster_enabled;
+    if (cmd.name == "ASKING") {
+        if (!cluster_enabled) {
+            return RESPParser::createError("ERR This instance has cluster support disabled");
+        }
+        client.asking = true;
+        return RESPParser::createSimpleString("OK");
+    }
+    if (cluster_enabled) {
+        if (auto redirect = clusterRedirect(cmd, asking)) {
+            client.multi_aborted |= client.in_multi;
+            return RESPParser::createError(*redirect);
+        }
+    }
+    if (cmd.name == "CLUSTER" || cmd.name == "MIGRATE") {
+        // Both may block on the store or the network, which must not happen
+        // while EXEC holds the store lock.
+        if (client.in_multi) {
+            client.multi_aborted = true;
+            return RESPParser::createError("ERR Command not allowed inside a transaction");
+        }
+        if (cmd.name == "MIGRATE" && client.event_loop) {
+            // Waiting on the target would stall every other connection.
+            return RESPParser::createError("ERR MIGRATE is not supported on the io_uring backend");
+        }
+        try {
+            return cmd.name == "CLUSTER" ? handleClusterCommand(cmd) : handleMigrate(cmd);
+        } catch (const CommandError& e) {
+            return RESPParser::createError(e.what());
+        }
+    }
+
+    if (cmd.name == "MULTI") {
+        if (client.in_multi) {
+            return RESPParser::createError("ERR MULTI calls can not be nested");
+        }
+        client.in_multi = true;
+        return RESPParser::createSimpleString("OK");
+    }
+    else if (cmd.name == "EXEC") {
+        if (!client.in_multi) {
+            return RESPParser::createError("ERR EXEC without MULTI");
+        }
+        if (client.multi_aborted) {
+            client.resetTransaction();
+            return RESPParser::createError("EXECABORT Transaction discarded because of previous errors.");
+        }
+        return execTransaction(client);
+    }
+    else if (cmd.name == "DISCARD") {
+        if (!client.in_multi) {
+            return RESPParser::createError("ERR DISCARD without MULTI");
+        }
+        client.resetTransaction();
+        return RESPParser::createSimpleString("OK");
+    }
+    else if (cmd.name == "WATCH") {
+        if (client.in_multi) {
+            return RESPParser::createError("ERR WATCH inside MULTI is not allowed");
+        }
+        if (cmd.args.empty()) {
+            throw std::runtime_error("WATCH command requires at least one key");
+        }
+        for (const auto& key : cmd.args) {
+            client.watched.emplace_back(key, kv_store.version(key));
+        }
+        return RESPParser::createSimpleString("OK");
+    }
+    else if (cmd.name == "UNWATCH") {
+        client.watched.clear();
+        return RESPParser::createSimpleString("OK");
+    }
+
+    if (client.in_multi) {
+        if (auto error = arityError(cmd)) {
+            client.multi_aborted = true;
+            return RESPParser::createError(*error);
+        }
+        client.queued.push_back(cmd);
+        return RESPParser::createSimpleString("QUEUED");
+    }
+    std::string reply;
+    try {
+        reply = executeCommand(cmd, kv_store, client);
+    } catch (const CommandError& e) {
+        reply = RESPParser::createError(e.what());
+    }
+    client_tracking.flushEvictions();
+    return reply;
+}
+
+std::string CommandHandler::execTransaction(ClientState& client) {
+    std::string reply;
+    {
+        // One store acquisition covers the WATCH check and the whole batch.
+        KeyValueStore::Transaction tx = kv_store.transaction();
+
+        for (const auto& [key, version] : client.watched) {
+            if (tx.version(key) != version) {
+                client.resetTransaction();
+                return RESPParser::createNullArray();
+            }
+        }
+
+        std::vector<std::string> replies;
+        replies.reserve(client.queued.size());
+        size_t total = 0;
+        for (const auto& queued : client.queued) {
+            try {
+                replies.push_back(executeCommand(queued, tx, client));
+            } catch (const CommandError& e) {
+                replies.push_back(RESPParser::createError(e.what()));
+            } catch (const std::exception& e) {
+                replies.push_back(RESPParser::createError("ERR " + std::string(e.what())));
+            }
+            total += replies.back().size();
+        }
+
+        reply.reserve(total + 16);
+        reply += "*" + std::to_string(replies.size()) + "\r\n";
+        for (const auto& r : replies) {
+            reply += r;
+        }
+    }
+    // Tracking-table evictions caused by the batch, now that the store lock
+    // is released.
+    client_tracking.flushEvictions();
+
+    client.resetTransaction();
+    return reply;
+}
+
+template <typename Store>
+std::string CommandHandler::executeCommand(const RESPParser::Command& cmd, Store& store, ClientState& client) {
     if (cmd.name == "PING") {
         return RESPParser::createSimpleString("PONG");
     } 
+    else if (cmd.name == "HELLO") {
+        return handleHello(cmd, client);
+    }
+    else if (cmd.name == "CLIENT") {
+        return handleClientCommand(cmd, client);
+    }
     else if (cmd.name == "ECHO") {
         if (cmd.args.empty()) {
             throw std::runtime_error("ECHO command requires an argument");
@@ -22,20 +668,50 @@ std::string CommandHandler::handleCommand(const RESPParser::Command& cmd) {
         return RESPParser::createBulkString(cmd.args[0]);
     }
     else if (cmd.name == "CONFIG") {
-        if (cmd.args.size() < 2) {
-            throw std::runtime_error("CONFIG command requires subcommand and parameter");
+        if (cmd.args.empty()) {
+            throw std::runtime_error("CONFIG command requires a subcommand");
         }
         
         std::string subcommand = cmd.args[0];
         std::transform(subcommand.begin(), subcommand.end(), subcommand.begin(), ::toupper);
         
         if (subcommand == "GET") {
-            std::string param = cmd.args[1];
-            auto value = config_manager.get(param);
-            if (!value) {
-                throw std::runtime_error("Unknown config parameter");
+            if (cmd.args.size() < 2) {
+                throw std::runtime_error("CONFIG GET requires a parameter");
+            }
+            std::vector<std::string> reply;
+            for (size_t i = 1; i < cmd.args.size(); ++i) {
+                for (auto& [name, value] : config_manager.match(cmd.args[i])) {
+                    if (std::find(reply.begin(), reply.end(), name) == reply.end()) {
+                        reply.push_back(std::move(name));
+                        reply.push_back(std::move(value));
+                    }
+                }
+            }
+            return RESPParser::createArray(reply);
+        }
+        if (subcommand == "SET") {
+            if (cmd.args.size() < 3 || cmd.args.size() % 2 == 0) {
+                return RESPParser::createError("ERR wrong number of arguments for 'config|set' command");
+            }
+            std::vector<std::pair<std::string, std::string>> changes;
+            for (size_t i = 1; i + 1 < cmd.args.size(); i += 2) {
+                changes.emplace_back(cmd.args[i], cmd.args[i + 1]);
+            }
+            try {
+                config_manager.set(changes);
+            } catch (const std::invalid_argument& e) {
+                return RESPParser::createError("ERR " + std::string(e.what()));
+            }
+            return RESPParser::createSimpleString("OK");
+        }
+        if (subcommand == "REWRITE") {
+            try {
+                config_manager.rewrite();
+            } catch (const std::exception& e) {
+                return RESPParser::createError("ERR " + std::string(e.what()));
             }
-            return RESPParser::createArray({param, *value});
+            return RESPParser::createSimpleString("OK");
         }
         throw std::runtime_error("Unknown CONFIG subcommand");
     }
@@ -53,42 +729,260 @@ std::string CommandHandler::handleCommand(const RESPParser::Command& cmd) {
                 expiry = std::chrono::milliseconds(std::stoll(cmd.args[3]));
             }
         }
+
+        checkMaxMemory();
         
-        kv_store.set(cmd.args[0], cmd.args[1], expiry);
+        store.set(cmd.args[0], cmd.args[1], expiry);
         return RESPParser::createSimpleString("OK");
     }
     else if (cmd.name == "GET") {
         if (cmd.args.empty()) {
             throw std::runtime_error("GET command requires a key argument");
         }
-        auto value = kv_store.get(cmd.args[0]);
+        trackRead(client, cmd.args[0]);
+        auto value = store.get(cmd.args[0]);
         if (value) {
             return RESPParser::createBulkString(*value);
         }
         return RESPParser::createNullBulkString();
     }
-    else if (cmd.name == "KEYS") {
+    else if (cmd.name == "SETBIT") {
+        if (cmd.args.size() != 3) {
+            throw CommandError("ERR wrong number of arguments for 'setbit' command");
+        }
+        auto offset = parseInteger(cmd.args[1]);
+        if (!offset || *offset < 0 || *offset >= (int64_t{1} << 32)) {
+            throw CommandError("ERR bit offset is not an integer or out of range");
+        }
+        if (cmd.args[2] != "0" && cmd.args[2] != "1") {
+            throw CommandError("ERR bit is not an integer or out of range");
+        }
+        checkMaxMemory();
+
+        return atomically(store, [&](KeyValueStore::Transaction& tx) {
+            std::string value = tx.get(cmd.args[0]).value_or("");
+            uint8_t old = bitmap::setBit(value, static_cast<uint64_t>(*offset), cmd.args[2] == "1");
+            tx.update(cmd.args[0], value);
+            return RESPParser::createInteger(old);
+        });
+    }
+    else if (cmd.name == "GETBIT") {
+        if (cmd.args.size() != 2) {
+            throw CommandError("ERR wrong number of arguments for 'getbit' command");
+        }
+        auto offset = parseInteger(cmd.args[1]);
+        if (!offset || *offset < 0 || *offset >= (int64_t{1} << 32)) {
+            throw CommandError("ERR bit offset is not an integer or out of range");
+        }
+        trackRead(client, cmd.args[0]);
+        auto value = store.get(cmd.args[0]);
+        return RESPParser::createInteger(value ? bitmap::getBit(*value, static_cast<uint64_t>(*offset)) : 0);
+    }
+    else if (cmd.name == "BITCOUNT") {
+        if (cmd.args.empty() || cmd.args.size() == 2 || cmd.args.size() > 4) {
+            throw CommandError(cmd.args.size() == 2 ? SYNTAX_ERROR
+                               : "ERR wrong number of arguments for 'bitcount' command");
+        }
+        int64_t start = 0, end = -1;
+        bool bit_unit = false;
+        if (cmd.args.size() >= 3) {
+            auto s = parseInteger(cmd.args[1]);
+            auto e = parseInteger(cmd.args[2]);
+            if (!s || !e) {
+                throw CommandError(NOT_AN_INTEGER);
+            }
+            start = *s;
+            end = *e;
+            if (cmd.args.size() == 4) {
+                bit_unit = parseBitUnit(cmd.args[3]);
+            }
+        }
+        trackRead(client, cmd.args[0]);
+        auto value = store.get(cmd.args[0]);
+        return RESPParser::createInteger(value ? bitmap::count(*value, start, end, bit_unit) : 0);
+    }
+    else if (cmd.name == "BITPOS") {
+        if (cmd.args.size() < 2 || cmd.args.size() > 5) {
+            throw CommandError("ERR wrong number of arguments for 'bitpos' command");
+        }
+        if (cmd.args[1] != "0" && cmd.args[1] != "1") {
+            throw CommandError("ERR The bit argument must be 1 or 0.");
+        }
+        int64_t start = 0;
+        std::optional<int64_t> end;
+        bool bit_unit = false;
+        if (cmd.args.size() >= 3) {
+            auto s = parseInteger(cmd.args[2]);
+            if (!s) {
+                throw CommandError(NOT_AN_INTEGER);
+            }
+            start = *s;
+        }
+        if (cmd.args.size() >= 4) {
+            end = parseInteger(cmd.args[3]);
+            if (!end) {
+                throw CommandError(NOT_AN_INTEGER);
+            }
+        }
+        if (cmd.args.size() == 5) {
+            bit_unit = parseBitUnit(cmd.args[4]);
+        }
+        bool bit = cmd.args[1] == "1";
+        trackRead(client, cmd.args[0]);
+        auto value = store.get(cmd.args[0]);
+        return RESPParser::createInteger(value ? bitmap::position(*value, bit, start, end, bit_unit)
+                                               : (bit ? -1 : 0));
+    }
+    else if (cmd.name == "BITOP") {
+        if (cmd.args.size() < 3) {
+            throw CommandError("ERR wrong number of arguments for 'bitop' command");
+        }
+        std::string op_name = cmd.args[0];
+        std::transform(op_name.begin(), op_name.end(), op_name.begin(), ::toupper);
+        bitmap::Op op;
+        if (op_name == "AND") op = bitmap::Op::And;
+        else if (op_name == "OR") op = bitmap::Op::Or;
+        else if (op_name == "XOR") op = bitmap::Op::Xor;
+        else if (op_name == "NOT") op = bitmap::Op::Not;
+        else throw CommandError(SYNTAX_ERROR);
+        if (op == bitmap::Op::Not && cmd.args.size() != 3) {
+            throw CommandError("ERR BITOP NOT must be called with a single source key.");
+        }
+        checkMaxMemory();
+
+        return atomically(store, [&](KeyValueStore::Transaction& tx) {
+            std::vector<std::optional<std::string>> sources;
+            for (size_t i = 2; i < cmd.args.size(); ++i) {
+                sources.push_back(tx.get(cmd.args[i]));
+            }
+            std::string result = bitmap::combine(op, sources);
+            if (result.empty()) {
+                tx.remove(cmd.args[1]);
+            } else {
+                tx.set(cmd.args[1], result);
+            }
+            return RESPParser::createInteger(static_cast<long long>(result.size()));
+        });
+    }
+    else if (cmd.name == "PFADD") {
         if (cmd.args.empty()) {
-            throw std::runtime_error("KEYS command requires a pattern argument");
+            throw CommandError("ERR wrong number of arguments for 'pfadd' command");
         }
+        checkMaxMemory();
 
-        if (cmd.args[0] == "*") {
-            try {
-                std::string dbdir = config_manager.get("dir").value_or("");
-                std::string dbfilename = config_manager.get("dbfilename").value_or("");
-                std::string full_path = dbdir + "/" + dbfilename;
+        return atomically(store, [&](KeyValueStore::Transaction& tx) {
+            bool exists = false;
+            HyperLogLog hll = loadHyperLogLog(tx, cmd.args[0], exists);
+            bool changed = !exists;
+            for (size_t i = 1; i < cmd.args.size(); ++i) {
+                changed |= hll.add(cmd.args[i]);
+            }
+            if (changed) {
+                tx.update(cmd.args[0], hll.serialize());
+            }
+            return RESPParser::createInteger(changed ? 1 : 0);
+        });
+    }
+    else if (cmd.name == "PFCOUNT") {
+        if (cmd.args.empty()) {
+            throw CommandError("ERR wrong number of arguments for 'pfcount' command");
+        }
 
-                RDBReader reader(full_path);
-                auto keys = reader.readKeys();
+        for (const auto& key : cmd.args) {
+            trackRead(client, key);
+        }
+        return atomically(store, [&](KeyValueStore::Transaction& tx) {
+            std::vector<HyperLogLog> hlls;
+            hlls.reserve(cmd.args.size());
+            for (const auto& key : cmd.args) {
+                bool exists = false;
+                hlls.push_back(loadHyperLogLog(tx, key, exists));
+            }
+            uint64_t estimate = hlls.size() == 1 ? hlls[0].count() : HyperLogLog::countUnion(hlls);
+            return RESPParser::createInteger(static_cast<long long>(estimate));
+        });
+    }
+    else if (cmd.name == "PFMERGE") {
+        if (cmd.args.empty()) {
+            throw CommandError("ERR wrong number of arguments for 'pfmerge' command");
+        }
+        checkMaxMemory();
 
-                return RESPParser::createArray(keys);
-            } catch (const std::exception& e) {
-                // Log the error if needed
-                return RESPParser::createArray({});
+        return atomically(store, [&](KeyValueStore::Transaction& tx) {
+            bool exists = false;
+            HyperLogLog merged = loadHyperLogLog(tx, cmd.args[0], exists);
+            for (size_t i = 1; i < cmd.args.size(); ++i) {
+                bool source_exists = false;
+                merged.merge(loadHyperLogLog(tx, cmd.args[i], source_exists));
             }
+            tx.update(cmd.args[0], merged.serialize());
+            return RESPParser::createSimpleString("OK");
+        });
+    }
+    else if (cmd.name == "DUMP") {
+        if (cmd.args.size() != 1) {
+            throw CommandError("ERR wrong number of arguments for 'dump' command");
+        }
+        // Strings are the only value type, so the payload is the value itself.
+        auto value = store.get(cmd.args[0]);
+        return value ? RESPParser::createBulkString(*value) : RESPParser::createNullBulkString();
+    }
+    else if (cmd.name == "RESTORE" || cmd.name == "RESTORE-ASKING") {
+        if (cmd.args.size() < 3) {
+            throw CommandError("ERR wrong number of arguments for '" + cmd.name + "' command");
+        }
+        auto ttl = parseInteger(cmd.args[1]);
+        if (!ttl || *ttl < 0) {
+            throw CommandError("ERR Invalid TTL value, must be >= 0");
         }
+        bool replace = false;
+        for (size_t i = 3; i < cmd.args.size(); ++i) {
+            std::string option = cmd.args[i];
+            std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+            if (option != "REPLACE") {
+                throw CommandError(SYNTAX_ERROR);
+            }
+            replace = true;
+        }
+        checkMaxMemory();
 
-        return RESPParser::createArray({});
+        return atomically(store, [&](KeyValueStore::Transaction& tx) {
+            if (!replace && tx.exists(cmd.args[0])) {
+                throw CommandError("BUSYKEY Target key name already exists.");
+            }
+            std::optional<std::chrono::milliseconds> expiry;
+            if (*ttl > 0) {
+                expiry = std::chrono::milliseconds(*ttl);
+            }
+            tx.set(cmd.args[0], cmd.args[2], expiry);
+            return RESPParser::createSimpleString("OK");
+        });
+    }
+    else if (cmd.name == "KEYS") {
+        if (cmd.args.empty()) {
+            throw std::runtime_error("KEYS command requires a pattern argument");
+        }
+
+        try {
+            std::string full_path;
+            {
+                ConfigManager::Snapshot config = config_manager.snapshot();
+                full_path = config->dir + "/" + config->dbfilename;
+            }
+
+            RDBReader reader(full_path);
+            auto keys = reader.readKeys();
+            if (cmd.args[0] != "*") {
+                std::erase_if(keys, [&](const std::string& key) {
+                    return !globMatch(cmd.args[0], key);
+                });
+            }
+
+            return RESPParser::createArray(keys);
+        } catch (const std::exception& e) {
+            // Log the error if needed
+            return RESPParser::createArray({});
+        }
     }
     throw std::runtime_error("Unknown command");
 }
\ No newline at end of file
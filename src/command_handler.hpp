@@ -4,18 +4,57 @@
 #include "key_value_store.hpp"
 #include "config_manager.hpp"
 #include "resp_parser.hpp"
+#include "client_state.hpp"
+#include "client_tracking.hpp"
+#include "cluster.hpp"
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
 #include <string>
 
+// Thrown for client errors that should be answered with a RESP error reply
+// (the message includes the error prefix, e.g. "ERR ..." or "WRONGTYPE ...")
+// instead of dropping the connection.
+class CommandError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
 class CommandHandler {
 private:
     KeyValueStore& kv_store;
     ConfigManager& config_manager;
+    ClientTracking& client_tracking;
+    ClusterState& cluster_state;
+    std::atomic<uint64_t> next_client_id{1};
 
     bool isNumber(const std::string& s);
+    static std::optional<int64_t> parseInteger(const std::string& s);
+    void checkMaxMemory() const;
+    void trackRead(const ClientState& client, const std::string& key);
+    std::string handleHello(const RESPParser::Command& cmd, ClientState& client);
+    std::string handleClientCommand(const RESPParser::Command& cmd, ClientState& client);
+    std::string execTransaction(ClientState& client);
+    // MOVED/ASK/CROSSSLOT/... error for a command whose keys this node must
+    // not serve right now; std::nullopt if it can run here.
+    std::optional<std::string> clusterRedirect(const RESPParser::Command& cmd, bool asking);
+    std::string handleClusterCommand(const RESPParser::Command& cmd);
+    std::string handleMigrate(const RESPParser::Command& cmd);
+
+    // Store is either KeyValueStore (locks per call) or
+    // KeyValueStore::Transaction (lock already held for a MULTI/EXEC batch).
+    template <typename Store>
+    std::string executeCommand(const RESPParser::Command& cmd, Store& store, ClientState& client);
 
 public:
-    CommandHandler(KeyValueStore& store, ConfigManager& cfg);
-    std::string handleCommand(const RESPParser::Command& cmd);
+    CommandHandler(KeyValueStore& store, ConfigManager& cfg, ClientTracking& tracking, ClusterState& cluster);
+
+    // Must bracket every connection: assigns the client id and registers
+    // where invalidation pushes for it are delivered.
+    void onConnect(ClientState& client, ClientTracking::PushSink push);
+    void onDisconnect(ClientState& client);
+    std::string handleCommand(const RESPParser::Command& cmd, ClientState& client);
 };
 
 #endif // COMMAND_HANDLER_HPP
\ No newline at end of file
@@ -1,36 +1,349 @@
 #include "config_manager.hpp"
+#include "glob_matcher.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 
-ConfigManager::ConfigManager() {
-    // Set default values
-    config["dir"] = "./";
-    config["dbfilename"] = "dump.rdb";
+namespace {
+
+std::string toLower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+uint64_t parseUnsigned(const std::string& value) {
+    if (value.empty() || !std::all_of(value.begin(), value.end(), ::isdigit)) {
+        throw std::invalid_argument("argument must be a number");
+    }
+    try {
+        return std::stoull(value);
+    } catch (const std::out_of_range&) {
+        throw std::invalid_argument("argument is out of range");
+    }
+}
+
+// Accepts plain byte counts and the k/kb/m/mb/g/gb suffixes used by redis.conf.
+uint64_t parseMemory(const std::string& value) {
+    std::string lower = toLower(value);
+    size_t digits = 0;
+    while (digits < lower.size() && std::isdigit(static_cast<unsigned char>(lower[digits]))) {
+        ++digits;
+    }
+    std::string unit = lower.substr(digits);
+    uint64_t multiplier = 1;
+    if (unit == "k") multiplier = 1000;
+    else if (unit == "kb") multiplier = 1024;
+    else if (unit == "m") multiplier = 1000 * 1000;
+    else if (unit == "mb") multiplier = 1024 * 1024;
+    else if (unit == "g") multiplier = 1000ULL * 1000 * 1000;
+    else if (unit == "gb") multiplier = 1024ULL * 1024 * 1024;
+    else if (!unit.empty()) throw std::invalid_argument("argument must be a memory value");
+
+    uint64_t amount = parseUnsigned(lower.substr(0, digits));
+    if (amount > UINT64_MAX / multiplier) {
+        throw std::invalid_argument("argument is out of range");
+    }
+    return amount * multiplier;
+}
+
+int parseBoundedInt(const std::string& value, int min, int max) {
+    uint64_t parsed = parseUnsigned(value);
+    if (parsed < static_cast<uint64_t>(min) || parsed > static_cast<uint64_t>(max)) {
+        throw std::invalid_argument("argument must be between " + std::to_string(min) +
+                                    " and " + std::to_string(max) + " inclusive");
+    }
+    return static_cast<int>(parsed);
+}
+
+bool parseYesNo(const std::string& value) {
+    std::string lower = toLower(value);
+    if (lower == "yes") return true;
+    if (lower == "no") return false;
+    throw std::invalid_argument("argument must be 'yes' or 'no'");
+}
+
+std::string quoteIfNeeded(const std::string& value) {
+    if (!value.empty() && value.find_first_of(" \t\"") == std::string::npos) {
+        return value;
+    }
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// Splits a config file line into "name value", honouring double quotes.
+std::optional<std::pair<std::string, std::string>> parseConfigLine(const std::string& line) {
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line[start] == '#') {
+        return std::nullopt;
+    }
+    size_t name_end = line.find_first_of(" \t", start);
+    std::string name = toLower(line.substr(start, name_end - start));
+    std::string value;
+    if (name_end != std::string::npos) {
+        size_t value_start = line.find_first_not_of(" \t", name_end);
+        if (value_start != std::string::npos) {
+            if (line[value_start] == '"') {
+                for (size_t i = value_start + 1; i < line.size() && line[i] != '"'; ++i) {
+                    if (line[i] == '\\' && i + 1 < line.size()) {
+                        ++i;
+                    }
+                    value += line[i];
+                }
+            } else {
+                size_t value_end = line.find_last_not_of(" \t\r");
+                value = line.substr(value_start, value_end - value_start + 1);
+            }
+        }
+    }
+    return std::make_pair(name, value);
+}
+
+} // namespace
+
+ConfigManager::ConfigManager() : current(nullptr) {
+    parameters = {
+        {"dir", true,
+         [](const ConfigSnapshot& c) { return c.dir; },
+         [](ConfigSnapshot& c, const std::string& v) {
+             if (v.empty()) throw std::invalid_argument("argument must not be empty");
+             c.dir = v;
+         }},
+        {"dbfilename", true,
+         [](const ConfigSnapshot& c) { return c.dbfilename; },
+         [](ConfigSnapshot& c, const std::string& v) {
+             if (v.empty() || v.find('/') != std::string::npos) {
+                 throw std::invalid_argument("dbfilename can't be a path, just a filename");
+             }
+             c.dbfilename = v;
+         }},
+        {"io-backend", false,
+         [](const ConfigSnapshot& c) { return c.io_backend; },
+         [](ConfigSnapshot& c, const std::string& v) {
+             std::string backend = toLower(v);
+             if (backend != "threads" && backend != "io_uring") {
+                 throw std::invalid_argument("argument must be one of: threads, io_uring");
+             }
+             c.io_backend = backend;
+         }},
+        {"maxmemory", true,
+         [](const ConfigSnapshot& c) { return std::to_string(c.maxmemory); },
+         [](ConfigSnapshot& c, const std::string& v) { c.maxmemory = parseMemory(v); }},
+        {"active-expire-effort", true,
+         [](const ConfigSnapshot& c) { return std::to_string(c.active_expire_effort); },
+         [](ConfigSnapshot& c, const std::string& v) { c.active_expire_effort = parseBoundedInt(v, 1, 10); }},
+        {"tracking-table-max-keys", true,
+         [](const ConfigSnapshot& c) { return std::to_string(c.tracking_table_max_keys); },
+         [](ConfigSnapshot& c, const std::string& v) { c.tracking_table_max_keys = parseUnsigned(v); }},
+        {"port", false,
+         [](const ConfigSnapshot& c) { return std::to_string(c.port); },
+         [](ConfigSnapshot& c, const std::string& v) { c.port = parseBoundedInt(v, 1, 65535); }},
+        {"cluster-enabled", false,
+         [](const ConfigSnapshot& c) { return std::string(c.cluster_enabled ? "yes" : "no"); },
+         [](ConfigSnapshot& c, const std::string& v) { c.cluster_enabled = parseYesNo(v); }},
+        {"cluster-announce-ip", false,
+         [](const ConfigSnapshot& c) { return c.cluster_announce_ip; },
+         [](ConfigSnapshot& c, const std::string& v) {
+             if (v.empty()) throw std::invalid_argument("argument must not be empty");
+             c.cluster_announce_ip = v;
+         }},
+        {"cluster-node-timeout", true,
+         [](const ConfigSnapshot& c) { return std::to_string(c.cluster_node_timeout); },
+         [](ConfigSnapshot& c, const std::string& v) {
+             uint64_t timeout = parseUnsigned(v);
+             if (timeout == 0) throw std::invalid_argument("argument must be greater than 0");
+             c.cluster_node_timeout = timeout;
+         }},
+    };
+
+    publish(std::make_unique<ConfigSnapshot>());
+}
+
+const ConfigManager::Parameter* ConfigManager::findParameter(const std::string& name) const {
+    std::string lower = toLower(name);
+    for (const auto& param : parameters) {
+        if (param.name == lower) {
+            return &param;
+        }
+    }
+    return nullptr;
+}
+
+ConfigManager::~ConfigManager() {
+    delete current.load();
+}
+
+void ConfigManager::publish(std::unique_ptr<ConfigSnapshot> next) {
+    const ConfigSnapshot* old = current.exchange(next.release(), std::memory_order_seq_cst);
+    if (old) {
+        waitForReaders();
+        delete old;
+    }
+}
+
+void ConfigManager::waitForReaders() {
+    // A reader that loaded the old pointer incremented one of the two phase
+    // counters of its shard before doing so. Waiting for both phases, each
+    // right after it stopped admitting new readers, covers a reader that
+    // read the phase just before a flip.
+    for (int i = 0; i < 2; ++i) {
+        unsigned previous = reader_phase.fetch_add(1, std::memory_order_seq_cst) & 1;
+        for (const auto& shard : readers) {
+            while (shard.phases[previous].load(std::memory_order_seq_cst) != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+void ConfigManager::apply(const std::vector<std::pair<std::string, std::string>>& changes, bool startup) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    auto next = std::make_unique<ConfigSnapshot>(*snapshot());
+
+    for (const auto& [name, value] : changes) {
+        const Parameter* param = findParameter(name);
+        if (!param) {
+            throw std::invalid_argument("Unknown option or number of arguments for CONFIG SET - '" + name + "'");
+        }
+        if (!startup && !param->runtime_mutable) {
+            throw std::invalid_argument("CONFIG SET failed (possibly related to argument '" + name +
+                                        "') - can't set immutable config");
+        }
+        try {
+            param->set(*next, value);
+        } catch (const std::invalid_argument& e) {
+            throw std::invalid_argument("CONFIG SET failed (possibly related to argument '" + name +
+                                        "') - " + e.what());
+        }
+    }
+
+    publish(std::move(next));
+}
+
+void ConfigManager::loadFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open config file " + path);
+    }
+
+    std::vector<std::pair<std::string, std::string>> changes;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (auto entry = parseConfigLine(line)) {
+            if (findParameter(entry->first)) {
+                changes.push_back(std::move(*entry));
+            }
+        }
+    }
+    apply(changes, true);
 }
 
 void ConfigManager::parseArgs(int argc, char** argv) {
-    for (int i = 1; i < argc; i += 2) {
+    int i = 1;
+    if (argc > 1 && std::string(argv[1]).rfind("--", 0) != 0) {
+        config_file = argv[1];
+        loadFile(config_file);
+        i = 2;
+    }
+
+    std::vector<std::pair<std::string, std::string>> changes;
+    for (; i < argc; i += 2) {
         if (i + 1 >= argc) break;
-        
+
         std::string arg = argv[i];
-        std::string value = argv[i + 1];
-        
-        if (arg == "--dir") {
-            set("dir", value);
-        } else if (arg == "--dbfilename") {
-            set("dbfilename", value);
+        if (arg.rfind("--", 0) == 0 && findParameter(arg.substr(2))) {
+            changes.emplace_back(arg.substr(2), argv[i + 1]);
         }
     }
+
+    try {
+        apply(changes, true);
+    } catch (const std::invalid_argument& e) {
+        throw std::runtime_error(e.what());
+    }
+}
+
+void ConfigManager::set(const std::vector<std::pair<std::string, std::string>>& changes) {
+    apply(changes, false);
 }
 
 void ConfigManager::set(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(mutex);
-    config[key] = value;
+    apply({{key, value}}, false);
 }
 
-std::optional<std::string> ConfigManager::get(const std::string& key) {
-    std::lock_guard<std::mutex> lock(mutex);
-    auto it = config.find(key);
-    if (it != config.end()) {
-        return it->second;
+std::optional<std::string> ConfigManager::get(const std::string& key) const {
+    const Parameter* param = findParameter(key);
+    if (!param) {
+        return std::nullopt;
     }
-    return std::nullopt;
-}
\ No newline at end of file
+    return param->get(*snapshot());
+}
+
+std::vector<std::pair<std::string, std::string>> ConfigManager::match(const std::string& pattern) const {
+    Snapshot config = snapshot();
+    std::vector<std::pair<std::string, std::string>> result;
+    for (const auto& param : parameters) {
+        if (globMatch(pattern, param.name, true)) {
+            result.emplace_back(param.name, param.get(*config));
+        }
+    }
+    return result;
+}
+
+void ConfigManager::rewrite() {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    if (config_file.empty()) {
+        throw std::runtime_error("The server is running without a config file");
+    }
+
+    Snapshot config = snapshot();
+    std::vector<std::string> lines;
+    std::vector<bool> written(parameters.size(), false);
+
+    // Keep comments and unknown directives; replace known ones in place.
+    std::ifstream in(config_file);
+    std::string line;
+    while (std::getline(in, line)) {
+        auto entry = parseConfigLine(line);
+        const Parameter* param = entry ? findParameter(entry->first) : nullptr;
+        if (!param) {
+            lines.push_back(line);
+            continue;
+        }
+        size_t index = param - parameters.data();
+        if (!written[index]) {
+            lines.push_back(param->name + " " + quoteIfNeeded(param->get(*config)));
+            written[index] = true;
+        }
+    }
+    in.close();
+
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        if (!written[i]) {
+            lines.push_back(parameters[i].name + " " + quoteIfNeeded(parameters[i].get(*config)));
+        }
+    }
+
+    std::string tmp_path = config_file + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        for (const auto& l : lines) {
+            out << l << '\n';
+        }
+        if (!out.good()) {
+            throw std::runtime_error("Failed to write config file " + tmp_path);
+        }
+    }
+    if (std::rename(tmp_path.c_str(), config_file.c_str()) != 0) {
+        throw std::runtime_error("Failed to replace config file " + config_file);
+    }
+}
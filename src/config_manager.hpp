@@ -1,21 +1,128 @@
 #ifndef CONFIG_MANAGER_HPP
 #define CONFIG_MANAGER_HPP
 
-#include <string>
-#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Immutable, typed view of every configuration parameter. Request paths read
+// fields through the handle returned by ConfigManager::snapshot().
+struct ConfigSnapshot {
+    std::string dir = "./";
+    std::string dbfilename = "dump.rdb";
+    std::string io_backend = "threads";
+    uint64_t maxmemory = 0;             // bytes, 0 = unlimited
+    int active_expire_effort = 1;       // 1..10
+    uint64_t tracking_table_max_keys = 1000000;   // 0 = unlimited
+    int port = 6379;
+    bool cluster_enabled = false;
+    std::string cluster_announce_ip = "127.0.0.1";  // Address other nodes and redirects use
+    uint64_t cluster_node_timeout = 15000;          // ms without a gossip reply before a node is suspect
+};
 
 class ConfigManager {
 private:
-    std::unordered_map<std::string, std::string> config;
-    std::mutex mutex;
+    struct Parameter {
+        std::string name;
+        bool runtime_mutable;
+        std::function<std::string(const ConfigSnapshot&)> get;
+        // Parses and validates value into the snapshot; throws std::invalid_argument.
+        std::function<void(ConfigSnapshot&, const std::string&)> set;
+    };
+
+    std::vector<Parameter> parameters;
+
+    // Readers pin the current snapshot without locking by bumping the
+    // counter of the active reader phase. Writers copy the snapshot, apply
+    // their changes, publish the copy and free the old one after a grace
+    // period: the phase is flipped twice and each previous phase's counters
+    // are waited down to zero, so no reader can still hold it. Counters are
+    // sharded by thread, one cache line per shard, so readers on different
+    // cores do not contend.
+    static constexpr size_t READER_SHARDS = 64;
+    struct alignas(64) ReaderShard {
+        std::array<std::atomic<uint64_t>, 2> phases{};
+    };
+
+    std::atomic<const ConfigSnapshot*> current;
+    mutable std::atomic<unsigned> reader_phase{0};
+    mutable std::array<ReaderShard, READER_SHARDS> readers{};
+    std::mutex write_mutex;
+    std::string config_file;
+
+    const Parameter* findParameter(const std::string& name) const;
+    void publish(std::unique_ptr<ConfigSnapshot> next);
+    void waitForReaders();
+    // Shard of the calling thread, assigned round-robin on first use.
+    static size_t readerShard() {
+        static std::atomic<size_t> next_shard{0};
+        thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % READER_SHARDS;
+        return shard;
+    }
+    void apply(const std::vector<std::pair<std::string, std::string>>& changes, bool startup);
+    void loadFile(const std::string& path);
 
 public:
+    // Keeps the snapshot that was current when it was taken alive until it
+    // is destroyed. Hold one for at most a request, and never across a call
+    // to set() on the same thread, which waits for it.
+    class Snapshot {
+    public:
+        Snapshot(Snapshot&& other) noexcept
+            : counter(std::exchange(other.counter, nullptr)), config(other.config) {}
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        Snapshot& operator=(Snapshot&&) = delete;
+        ~Snapshot() {
+            if (counter) {
+                counter->fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        const ConfigSnapshot* operator->() const { return config; }
+        const ConfigSnapshot& operator*() const { return *config; }
+
+    private:
+        friend class ConfigManager;
+        Snapshot(std::atomic<uint64_t>* counter, const ConfigSnapshot* config)
+            : counter(counter), config(config) {}
+
+        std::atomic<uint64_t>* counter;
+        const ConfigSnapshot* config;
+    };
+
     ConfigManager();
+    ~ConfigManager();
+    ConfigManager(const ConfigManager&) = delete;
+    ConfigManager& operator=(const ConfigManager&) = delete;
     void parseArgs(int argc, char** argv);
+
+    Snapshot snapshot() const {
+        std::atomic<uint64_t>& counter =
+            readers[readerShard()].phases[reader_phase.load(std::memory_order_seq_cst) & 1];
+        counter.fetch_add(1, std::memory_order_seq_cst);
+        return Snapshot(&counter, current.load(std::memory_order_seq_cst));
+    }
+
+    // Runtime update (CONFIG SET). All changes are validated before any is
+    // published; throws std::invalid_argument on unknown, read-only or
+    // malformed parameters.
+    void set(const std::vector<std::pair<std::string, std::string>>& changes);
     void set(const std::string& key, const std::string& value);
-    std::optional<std::string> get(const std::string& key);
+
+    std::optional<std::string> get(const std::string& key) const;
+    std::vector<std::pair<std::string, std::string>> match(const std::string& pattern) const;
+
+    // Writes the current configuration to the file the server was started
+    // with; throws std::runtime_error if there is none.
+    void rewrite();
 };
 
-#endif // CONFIG_MANAGER_HPP
\ No newline at end of file
+#endif // CONFIG_MANAGER_HPP
@@ -0,0 +1,100 @@
+#include "glob_matcher.hpp"
+#include <cctype>
+#include <utility>
+
+namespace {
+
+char fold(char c, bool nocase) {
+    return nocase ? static_cast<char>(std::tolower(static_cast<unsigned char>(c))) : c;
+}
+
+// Matches a '[...]' class starting just after the '['. Advances p past the
+// closing ']' and returns whether c is a member.
+bool matchClass(std::string_view pattern, size_t& p, char c, bool nocase) {
+    bool negate = p < pattern.size() && pattern[p] == '^';
+    if (negate) {
+        ++p;
+    }
+
+    bool matched = false;
+    while (p < pattern.size() && pattern[p] != ']') {
+        if (pattern[p] == '\\' && p + 1 < pattern.size()) {
+            ++p;
+            matched |= fold(pattern[p], nocase) == fold(c, nocase);
+        } else if (p + 2 < pattern.size() && pattern[p + 1] == '-' && pattern[p + 2] != ']') {
+            char lo = fold(pattern[p], nocase);
+            char hi = fold(pattern[p + 2], nocase);
+            if (lo > hi) {
+                std::swap(lo, hi);
+            }
+            char folded = fold(c, nocase);
+            matched |= folded >= lo && folded <= hi;
+            p += 2;
+        } else {
+            matched |= fold(pattern[p], nocase) == fold(c, nocase);
+        }
+        ++p;
+    }
+    if (p < pattern.size()) {
+        ++p; // skip ']'
+    }
+    return negate ? !matched : matched;
+}
+
+} // namespace
+
+bool globMatch(std::string_view pattern, std::string_view str, bool nocase) {
+    size_t p = 0, s = 0;
+    size_t star_p = std::string_view::npos, star_s = 0;
+
+    while (s < str.size()) {
+        if (p < pattern.size()) {
+            char pc = pattern[p];
+            if (pc == '*') {
+                while (p < pattern.size() && pattern[p] == '*') {
+                    ++p;
+                }
+                if (p == pattern.size()) {
+                    return true;
+                }
+                star_p = p;
+                star_s = s;
+                continue;
+            }
+            if (pc == '?') {
+                ++p;
+                ++s;
+                continue;
+            }
+            if (pc == '[') {
+                size_t next = p + 1;
+                if (matchClass(pattern, next, str[s], nocase)) {
+                    p = next;
+                    ++s;
+                    continue;
+                }
+            } else {
+                if (pc == '\\' && p + 1 < pattern.size()) {
+                    ++p;
+                    pc = pattern[p];
+                }
+                if (fold(pc, nocase) == fold(str[s], nocase)) {
+                    ++p;
+                    ++s;
+                    continue;
+                }
+            }
+        }
+        // Mismatch: backtrack to the last '*' and let it absorb one more char.
+        if (star_p == std::string_view::npos) {
+            return false;
+        }
+        p = star_p;
+        s = ++star_s;
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
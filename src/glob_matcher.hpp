@@ -0,0 +1,10 @@
+#ifndef GLOB_MATCHER_HPP
+#define GLOB_MATCHER_HPP
+
+#include <string_view>
+
+// Redis-style glob matching supporting '*', '?', '[...]' classes (with '^'
+// negation and ranges) and '\' escapes.
+bool globMatch(std::string_view pattern, std::string_view str, bool nocase = false);
+
+#endif // GLOB_MATCHER_HPP
@@ -0,0 +1,280 @@
+#include "hyperloglog.hpp"
+#include "simd_kernels.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr char MAGIC[4] = {'H', 'Y', 'L', 'L'};
+constexpr size_t HEADER_SIZE = sizeof(MAGIC) + 1;
+constexpr uint8_t ENCODING_SPARSE = 0;
+constexpr uint8_t ENCODING_DENSE = 1;
+constexpr uint64_t HASH_SEED = 0xadc83b19ULL;
+
+// MurmurHash64A, the element hash Redis uses for HyperLogLog.
+uint64_t murmurHash64A(const void* key, size_t len, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (len * m);
+
+    const uint8_t* data = static_cast<const uint8_t*>(key);
+    const uint8_t* end = data + (len - (len & 7));
+    while (data != end) {
+        uint64_t k;
+        std::memcpy(&k, data, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+        data += 8;
+    }
+
+    switch (len & 7) {
+        case 7: h ^= uint64_t(data[6]) << 48; [[fallthrough]];
+        case 6: h ^= uint64_t(data[5]) << 40; [[fallthrough]];
+        case 5: h ^= uint64_t(data[4]) << 32; [[fallthrough]];
+        case 4: h ^= uint64_t(data[3]) << 24; [[fallthrough]];
+        case 3: h ^= uint64_t(data[2]) << 16; [[fallthrough]];
+        case 2: h ^= uint64_t(data[1]) << 8; [[fallthrough]];
+        case 1: h ^= uint64_t(data[0]);
+                h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+// Helper functions of Ertl's improved raw estimator
+// ("New cardinality estimation algorithms for HyperLogLog sketches").
+double tau(double x) {
+    if (x == 0.0 || x == 1.0) {
+        return 0.0;
+    }
+    double z_prev;
+    double y = 1.0;
+    double z = 1 - x;
+    do {
+        x = std::sqrt(x);
+        z_prev = z;
+        y *= 0.5;
+        z -= std::pow(1 - x, 2) * y;
+    } while (z_prev != z);
+    return z / 3;
+}
+
+double sigma(double x) {
+    if (x == 1.0) {
+        return INFINITY;
+    }
+    double z_prev;
+    double y = 1;
+    double z = x;
+    do {
+        x *= x;
+        z_prev = z;
+        z += x * y;
+        y += y;
+    } while (z_prev != z);
+    return z;
+}
+
+} // namespace
+
+std::optional<HyperLogLog> HyperLogLog::parse(const std::string& value) {
+    if (value.size() < HEADER_SIZE || std::memcmp(value.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        return std::nullopt;
+    }
+
+    HyperLogLog hll;
+    const uint8_t* body = reinterpret_cast<const uint8_t*>(value.data()) + HEADER_SIZE;
+    size_t body_len = value.size() - HEADER_SIZE;
+    uint8_t encoding = static_cast<uint8_t>(value[sizeof(MAGIC)]);
+
+    if (encoding == ENCODING_DENSE) {
+        if (body_len != REGISTERS) {
+            return std::nullopt;
+        }
+        // Register values index the estimator's histogram, so a stored value
+        // outside 0..Q+1 must never get past here.
+        uint8_t highest = 0;
+        for (size_t i = 0; i < body_len; ++i) {
+            highest = std::max(highest, body[i]);
+        }
+        if (highest > Q + 1) {
+            return std::nullopt;
+        }
+        hll.dense = true;
+        hll.registers.assign(body, body + body_len);
+        return hll;
+    }
+
+    if (encoding != ENCODING_SPARSE || body_len % 3 != 0) {
+        return std::nullopt;
+    }
+    hll.sparse.reserve(body_len / 3);
+    for (size_t i = 0; i < body_len; i += 3) {
+        uint16_t index = static_cast<uint16_t>(body[i] | (body[i + 1] << 8));
+        // Entries must be strictly increasing by index (setRegister searches
+        // them) and hold non-zero values (count() derives the number of
+        // zero registers from the entry count).
+        if (index >= REGISTERS || body[i + 2] == 0 || body[i + 2] > Q + 1 ||
+            (!hll.sparse.empty() && index <= hll.sparse.back().index)) {
+            return std::nullopt;
+        }
+        hll.sparse.push_back({index, body[i + 2]});
+    }
+    return hll;
+}
+
+std::string HyperLogLog::serialize() const {
+    std::string out(MAGIC, sizeof(MAGIC));
+    out.push_back(static_cast<char>(dense ? ENCODING_DENSE : ENCODING_SPARSE));
+
+    if (dense) {
+        out.append(reinterpret_cast<const char*>(registers.data()), registers.size());
+        return out;
+    }
+
+    out.reserve(HEADER_SIZE + sparse.size() * 3);
+    for (const auto& entry : sparse) {
+        out.push_back(static_cast<char>(entry.index & 0xff));
+        out.push_back(static_cast<char>(entry.index >> 8));
+        out.push_back(static_cast<char>(entry.value));
+    }
+    return out;
+}
+
+bool HyperLogLog::add(const std::string& element) {
+    uint64_t hash = murmurHash64A(element.data(), element.size(), HASH_SEED);
+    uint16_t index = static_cast<uint16_t>(hash & (REGISTERS - 1));
+
+    // Position of the first set bit in the remaining Q bits, 1-based. The
+    // sentinel bit caps the run length at Q+1.
+    hash >>= PRECISION;
+    hash |= uint64_t{1} << Q;
+    uint8_t run = static_cast<uint8_t>(__builtin_ctzll(hash) + 1);
+
+    return setRegister(index, run);
+}
+
+bool HyperLogLog::setRegister(uint16_t index, uint8_t value) {
+    if (dense) {
+        if (registers[index] >= value) {
+            return false;
+        }
+        registers[index] = value;
+        return true;
+    }
+
+    auto it = std::lower_bound(sparse.begin(), sparse.end(), index,
+                               [](const SparseEntry& e, uint16_t i) { return e.index < i; });
+    if (it != sparse.end() && it->index == index) {
+        if (it->value >= value) {
+            return false;
+        }
+        it->value = value;
+        return true;
+    }
+
+    sparse.insert(it, {index, value});
+    if (HEADER_SIZE + sparse.size() * 3 > SPARSE_MAX_BYTES) {
+        promote();
+    }
+    return true;
+}
+
+void HyperLogLog::toDense(std::vector<uint8_t>& out) const {
+    if (dense) {
+        out = registers;
+        return;
+    }
+    out.assign(REGISTERS, 0);
+    for (const auto& entry : sparse) {
+        out[entry.index] = entry.value;
+    }
+}
+
+void HyperLogLog::promote() {
+    if (dense) {
+        return;
+    }
+    toDense(registers);
+    sparse.clear();
+    sparse.shrink_to_fit();
+    dense = true;
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    if (!dense && !other.dense) {
+        for (const auto& entry : other.sparse) {
+            setRegister(entry.index, entry.value);
+        }
+        return;
+    }
+
+    promote();
+    if (other.dense) {
+        simd::maxBytes(registers.data(), other.registers.data(), REGISTERS);
+    } else {
+        for (const auto& entry : other.sparse) {
+            registers[entry.index] = std::max(registers[entry.index], entry.value);
+        }
+    }
+}
+
+uint64_t HyperLogLog::estimate(const uint32_t* histogram) {
+    constexpr double ALPHA_INF = 0.721347520444481703680;
+    const double m = static_cast<double>(REGISTERS);
+
+    double z = m * tau((m - histogram[Q + 1]) / m);
+    for (int j = Q; j >= 1; --j) {
+        z += histogram[j];
+        z *= 0.5;
+    }
+    z += m * sigma(histogram[0] / m);
+    // Only a crafted value with every register saturated reaches z == 0.
+    double estimate = ALPHA_INF * m * m / z;
+    if (!(estimate < static_cast<double>(INT64_MAX))) {
+        return INT64_MAX;
+    }
+    return static_cast<uint64_t>(std::llround(estimate));
+}
+
+uint64_t HyperLogLog::estimateDense(const uint8_t* regs) {
+    uint32_t histogram[Q + 2] = {};
+    for (size_t i = 0; i < REGISTERS; ++i) {
+        ++histogram[regs[i]];
+    }
+    return estimate(histogram);
+}
+
+uint64_t HyperLogLog::count() const {
+    if (dense) {
+        return estimateDense(registers.data());
+    }
+    uint32_t histogram[Q + 2] = {};
+    histogram[0] = static_cast<uint32_t>(REGISTERS - sparse.size());
+    for (const auto& entry : sparse) {
+        ++histogram[entry.value];
+    }
+    return estimate(histogram);
+}
+
+uint64_t HyperLogLog::countUnion(const std::vector<HyperLogLog>& hlls) {
+    std::vector<uint8_t> merged(REGISTERS, 0);
+    for (const auto& hll : hlls) {
+        if (hll.dense) {
+            simd::maxBytes(merged.data(), hll.registers.data(), REGISTERS);
+        } else {
+            for (const auto& entry : hll.sparse) {
+                merged[entry.index] = std::max(merged[entry.index], entry.value);
+            }
+        }
+    }
+    return estimateDense(merged.data());
+}
@@ -0,0 +1,60 @@
+#ifndef HYPERLOGLOG_HPP
+#define HYPERLOGLOG_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// HyperLogLog with 2^14 registers (0.81% standard error) serialised into a
+// plain string value so it lives in KeyValueStore like any other key.
+//
+// Layout: "HYLL", one encoding byte, then either
+//   sparse: sorted (register index: u16 LE, value: u8) triples for the
+//           non-zero registers, or
+//   dense:  one byte per register.
+// Byte-wide dense registers cost 4KB more than a 6-bit packing but let
+// merges run as a single vector max over the array.
+class HyperLogLog {
+public:
+    static constexpr int PRECISION = 14;
+    static constexpr size_t REGISTERS = size_t{1} << PRECISION;
+    // Sparse values larger than this are promoted to the dense encoding.
+    static constexpr size_t SPARSE_MAX_BYTES = 3000;
+
+    HyperLogLog() = default;
+
+    // Returns nullopt if value is not a serialised HyperLogLog.
+    static std::optional<HyperLogLog> parse(const std::string& value);
+    std::string serialize() const;
+
+    // Returns true if any register changed.
+    bool add(const std::string& element);
+    void merge(const HyperLogLog& other);
+    uint64_t count() const;
+
+    bool isDense() const { return dense; }
+
+    // Merges the registers of several HLLs and estimates their union.
+    static uint64_t countUnion(const std::vector<HyperLogLog>& hlls);
+
+private:
+    struct SparseEntry {
+        uint16_t index;
+        uint8_t value;
+    };
+
+    bool dense = false;
+    std::vector<SparseEntry> sparse;     // sorted by index
+    std::vector<uint8_t> registers;      // REGISTERS bytes when dense
+
+    bool setRegister(uint16_t index, uint8_t value);
+    void promote();
+    void toDense(std::vector<uint8_t>& out) const;
+    static constexpr int Q = 64 - PRECISION;   // Register values range over 0..Q+1
+
+    static uint64_t estimate(const uint32_t* histogram);
+    static uint64_t estimateDense(const uint8_t* registers);
+};
+
+#endif // HYPERLOGLOG_HPP
@@ -0,0 +1,582 @@
+#include "io_uring_backend.hpp"
+#include "resp_parser.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+int sysIoUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sysIoUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int sysIoUringRegister(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template <typename T>
+T* ringField(void* base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+} // namespace
+
+IoUringBackend::IoUringBackend(int server_fd, CommandHandler& handler, Logger logger)
+    : server_fd(server_fd),
+      command_handler(handler),
+      log(std::move(logger)),
+      buffers(static_cast<size_t>(BUFFER_COUNT) * BUFFER_SIZE) {
+    try {
+        setupRing();
+        setupBuffers();
+        probeMultishot();
+    } catch (...) {
+        releaseResources();
+        throw;
+    }
+}
+
+IoUringBackend::~IoUringBackend() {
+    releaseResources();
+}
+
+void IoUringBackend::releaseResources() {
+    for (auto& [fd, conn] : connections) {
+        command_handler.onDisconnect(conn.client);
+        close(fd);
+    }
+    connections.clear();
+
+    if (buf_ring) {
+        munmap(buf_ring, buf_ring_size);
+        buf_ring = nullptr;
+    }
+    if (sqes) {
+        munmap(sqes, sqes_size);
+        sqes = nullptr;
+    }
+    if (sq_ring_ptr) {
+        munmap(sq_ring_ptr, sq_ring_size);
+        sq_ring_ptr = nullptr;
+        cq_ring_ptr = nullptr;
+    }
+    if (ring_fd >= 0) {
+        close(ring_fd);
+        ring_fd = -1;
+    }
+}
+
+void IoUringBackend::setupRing() {
+    io_uring_params params{};
+    ring_fd = sysIoUringSetup(RING_ENTRIES, &params);
+    if (ring_fd < 0) {
+        throw std::runtime_error("io_uring_setup failed: " + std::string(strerror(errno)));
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        throw std::runtime_error("io_uring kernel support is too old");
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+    sq_ring_ptr = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ptr == MAP_FAILED) {
+        sq_ring_ptr = nullptr;
+        throw std::runtime_error("Failed to map io_uring rings");
+    }
+    cq_ring_ptr = sq_ring_ptr;
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes_ptr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED) {
+        throw std::runtime_error("Failed to map io_uring submission entries");
+    }
+    sqes = static_cast<io_uring_sqe*>(sqes_ptr);
+
+    sq_head = ringField<unsigned>(sq_ring_ptr, params.sq_off.head);
+    sq_tail = ringField<unsigned>(sq_ring_ptr, params.sq_off.tail);
+    sq_mask = ringField<unsigned>(sq_ring_ptr, params.sq_off.ring_mask);
+    sq_array = ringField<unsigned>(sq_ring_ptr, params.sq_off.array);
+    sq_entries = params.sq_entries;
+    sqe_tail = *sq_tail;
+
+    cq_head = ringField<unsigned>(cq_ring_ptr, params.cq_off.head);
+    cq_tail = ringField<unsigned>(cq_ring_ptr, params.cq_off.tail);
+    cq_mask = ringField<unsigned>(cq_ring_ptr, params.cq_off.ring_mask);
+    cqes = ringField<io_uring_cqe>(cq_ring_ptr, params.cq_off.cqes);
+}
+
+void IoUringBackend::setupBuffers() {
+    use_buf_ring = setupBufferRing() && probeBufferRing();
+    if (use_buf_ring) {
+        return;
+    }
+
+    if (buf_ring) {
+        io_uring_buf_reg reg{};
+        reg.bgid = BUFFER_GROUP;
+        sysIoUringRegister(ring_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        munmap(buf_ring, buf_ring_size);
+        buf_ring = nullptr;
+    }
+
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = BUFFER_COUNT;
+    sqe->addr = reinterpret_cast<uint64_t>(buffers.data());
+    sqe->len = BUFFER_SIZE;
+    sqe->off = 0;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = encode(Op::Provide, 0);
+    io_uring_cqe cqe = waitCqe();
+    if (cqe.res < 0) {
+        throw std::runtime_error("Failed to provide receive buffers: " + std::string(strerror(-cqe.res)));
+    }
+}
+
+bool IoUringBackend::setupBufferRing() {
+    buf_ring_size = BUFFER_COUNT * sizeof(io_uring_buf);
+    void* ptr = mmap(nullptr, buf_ring_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    buf_ring = static_cast<io_uring_buf_ring*>(ptr);
+
+    // Populate the ring before registering it so the kernel pins the pages we
+    // write to rather than the shared zero page of an untouched mapping.
+    for (uint16_t bid = 0; bid < BUFFER_COUNT; ++bid) {
+        io_uring_buf& buf = buf_ring->bufs[bid];
+        buf.addr = reinterpret_cast<uint64_t>(buffers.data() + static_cast<size_t>(bid) * BUFFER_SIZE);
+        buf.len = BUFFER_SIZE;
+        buf.bid = bid;
+    }
+    __atomic_store_n(&buf_ring->tail, static_cast<uint16_t>(BUFFER_COUNT), __ATOMIC_RELEASE);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring);
+    reg.ring_entries = BUFFER_COUNT;
+    reg.bgid = BUFFER_GROUP;
+    return sysIoUringRegister(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0;
+}
+
+bool IoUringBackend::probeBufferRing() {
+    // Some kernels accept the ring registration but never hand out its
+    // buffers, so read one byte through it before relying on it.
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    char byte = 0;
+    bool ok = write(fds[1], &byte, 1) == 1;
+    if (ok) {
+        io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fds[0];
+        sqe->off = static_cast<uint64_t>(-1);
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->user_data = encode(Op::Probe, fds[0]);
+        io_uring_cqe cqe = waitCqe();
+        ok = cqe.res == 1 && (cqe.flags & IORING_CQE_F_BUFFER);
+        if (ok) {
+            recycleBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+        }
+    }
+    close(fds[0]);
+    close(fds[1]);
+    return ok;
+}
+
+void IoUringBackend::probeMultishot() {
+    // Multishot accept (5.19) and recv (6.0) are newer than the rest of what
+    // the loop needs. Older kernels fail them with -EINVAL on every re-arm,
+    // so accept and receive one byte over loopback before committing.
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int client = -1;
+    int accepted = -1;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    bool ok = listener >= 0 &&
+              bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+              listen(listener, 1) == 0 &&
+              getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addr_len) == 0;
+
+    if (ok) {
+        io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = listener;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->user_data = encode(Op::Probe, listener);
+        client = socket(AF_INET, SOCK_STREAM, 0);
+        ok = client >= 0 && connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    }
+    if (ok) {
+        io_uring_cqe cqe = waitCqe();
+        accepted = cqe.res;
+        ok = cqe.res >= 0 && (cqe.flags & IORING_CQE_F_MORE);
+    }
+    if (ok) {
+        io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = accepted;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->user_data = encode(Op::Probe, accepted);
+        char byte = 0;
+        ok = send(client, &byte, 1, MSG_NOSIGNAL) == 1;
+    }
+    if (ok) {
+        io_uring_cqe cqe = waitCqe();
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            recycleBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+        }
+        ok = cqe.res == 1 && (cqe.flags & IORING_CQE_F_MORE);
+    }
+    if (ok) {
+        // Cancel both probes and reap the two cancel results plus the final
+        // completion of each multishot request.
+        for (int fd : {listener, accepted}) {
+            io_uring_sqe* sqe = getSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = encode(Op::Probe, fd);
+            sqe->user_data = encode(Op::Probe, -1);
+        }
+        for (int remaining = 4; remaining > 0;) {
+            io_uring_cqe cqe = waitCqe();
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                recycleBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+            if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                --remaining;
+            }
+        }
+    }
+
+    for (int fd : {accepted, client, listener}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    if (!ok) {
+        throw std::runtime_error("kernel lacks multishot accept/recv support");
+    }
+}
+
+io_uring_cqe IoUringBackend::waitCqe() {
+    unsigned head = *cq_head;
+    while (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        submitAndWait(1);
+    }
+    io_uring_cqe cqe = cqes[head & *cq_mask];
+    __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+    return cqe;
+}
+
+uint64_t IoUringBackend::encode(Op op, int fd) {
+    return (static_cast<uint64_t>(op) << 32) | static_cast<uint32_t>(fd);
+}
+
+io_uring_sqe* IoUringBackend::getSqe() {
+    if (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+        submitAndWait(0);
+    }
+    unsigned index = sqe_tail & *sq_mask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    ++sqe_tail;
+    ++to_submit;
+    return sqe;
+}
+
+void IoUringBackend::submitAndWait(unsigned wait_nr) {
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+    for (;;) {
+        int ret = sysIoUringEnter(ring_fd, to_submit, wait_nr, IORING_ENTER_GETEVENTS);
+        if (ret >= 0) {
+            to_submit -= std::min<unsigned>(to_submit, static_cast<unsigned>(ret));
+            return;
+        }
+        if (errno != EINTR) {
+            throw std::runtime_error("io_uring_enter failed: " + std::string(strerror(errno)));
+        }
+    }
+}
+
+void IoUringBackend::recycleBuffer(uint16_t bid) {
+    char* addr = buffers.data() + static_cast<size_t>(bid) * BUFFER_SIZE;
+    if (!use_buf_ring) {
+        io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = 1;
+        sqe->addr = reinterpret_cast<uint64_t>(addr);
+        sqe->len = BUFFER_SIZE;
+        sqe->off = bid;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+        sqe->user_data = encode(Op::Provide, 0);
+        return;
+    }
+
+    uint16_t tail = buf_ring->tail;
+    io_uring_buf& buf = buf_ring->bufs[tail & (BUFFER_COUNT - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(addr);
+    buf.len = BUFFER_SIZE;
+    buf.bid = bid;
+    __atomic_store_n(&buf_ring->tail, static_cast<uint16_t>(tail + 1), __ATOMIC_RELEASE);
+}
+
+void IoUringBackend::armAccept() {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = encode(Op::Accept, server_fd);
+}
+
+void IoUringBackend::armRecv(int fd) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = encode(Op::Recv, fd);
+}
+
+void IoUringBackend::armTimer() {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&tick_timeout);
+    sqe->len = 1;
+    sqe->user_data = encode(Op::Timer, 0);
+}
+
+void IoUringBackend::queueSend(int fd, Connection& conn) {
+    if (conn.inflight_offset >= conn.inflight.size()) {
+        conn.inflight.clear();
+        conn.inflight.swap(conn.pending);
+        conn.inflight_offset = 0;
+    }
+
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(conn.inflight.data() + conn.inflight_offset);
+    sqe->len = static_cast<uint32_t>(conn.inflight.size() - conn.inflight_offset);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = encode(Op::Send, fd);
+    conn.sending = true;
+}
+
+void IoUringBackend::handleAccept(const io_uring_cqe& cqe) {
+    if (cqe.res >= 0) {
+        log("Client connected");
+        int fd = cqe.res;
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        Connection& conn = connections[fd];
+        conn.client.event_loop = true;
+        // Invalidations are produced by commands and by the tick, which all
+        // run on this thread, so the push can be queued like any other reply.
+        command_handler.onConnect(conn.client, [this, fd](const std::string& message) {
+            auto it = connections.find(fd);
+            if (it == connections.end() || it->second.closing) {
+                return;
+            }
+            if (it->second.executing) {
+                it->second.pushes += message;
+            } else {
+                it->second.pending += message;
+                ready_to_send.push_back(fd);
+            }
+        });
+        armRecv(fd);
+    } else if (cqe.res == -EINVAL) {
+        // The request itself is unsupported; re-arming would fail the same
+        // way forever. Unwinding out of run() falls back to threads.
+        throw std::runtime_error("multishot accept rejected by the kernel");
+    } else {
+        log("Failed to accept client connection");
+    }
+
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        armAccept();
+    }
+}
+
+void IoUringBackend::handleRecv(int fd, const io_uring_cqe& cqe) {
+    auto it = connections.find(fd);
+    if (it == connections.end()) {
+        return;
+    }
+    Connection& conn = it->second;
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+
+    if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+        uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        conn.input.append(buffers.data() + static_cast<size_t>(bid) * BUFFER_SIZE, cqe.res);
+        recycleBuffer(bid);
+
+        if (!conn.closing) {
+            try {
+                size_t offset = 0;
+                size_t consumed = 0;
+                std::string_view input(conn.input);
+                while (auto cmd = RESPParser::tryParseCommand(input.substr(offset), consumed, conn.parse_state)) {
+                    // A command's own pushes (its writes, tracking evictions)
+                    // must not overtake its reply, or the client would cache
+                    // a value it was just told to drop.
+                    conn.executing = true;
+                    std::string reply = command_handler.handleCommand(*cmd, conn.client);
+                    conn.executing = false;
+                    conn.pending += reply;
+                    conn.pending += conn.pushes;
+                    conn.pushes.clear();
+                    offset += consumed;
+                }
+                conn.input.erase(0, offset);
+                if (offset > 0) {
+                    ready_to_send.push_back(fd);
+                }
+            } catch (const std::exception& e) {
+                log("Error processing command: " + std::string(e.what()));
+                failConnection(fd, conn);
+            }
+        }
+
+        if (!more) {
+            armRecv(fd);
+        }
+        return;
+    }
+
+    if (more) {
+        return;
+    }
+    if (cqe.res == -ENOBUFS && !conn.closing) {
+        armRecv(fd);
+        return;
+    }
+
+    if (cqe.res == 0) {
+        log("Client disconnected");
+    } else if (!conn.closing) {
+        log("Error reading from client");
+    }
+    conn.receiving = false;
+    if (!conn.sending) {
+        closeConnection(fd);
+    }
+}
+
+void IoUringBackend::handleSend(int fd, const io_uring_cqe& cqe) {
+    auto it = connections.find(fd);
+    if (it == connections.end()) {
+        return;
+    }
+    Connection& conn = it->second;
+    conn.sending = false;
+
+    if (cqe.res < 0) {
+        log("Error sending response");
+        failConnection(fd, conn);
+    } else {
+        conn.inflight_offset += static_cast<size_t>(cqe.res);
+        ready_to_send.push_back(fd);
+    }
+
+    if (!conn.receiving) {
+        closeConnection(fd);
+    }
+}
+
+void IoUringBackend::failConnection(int fd, Connection& conn) {
+    // Shutting the socket down terminates the multishot recv; the fd is only
+    // closed once that final completion has been reaped.
+    conn.closing = true;
+    conn.pending.clear();
+    conn.inflight.clear();
+    conn.inflight_offset = 0;
+    shutdown(fd, SHUT_RDWR);
+}
+
+void IoUringBackend::closeConnection(int fd) {
+    auto it = connections.find(fd);
+    if (it != connections.end()) {
+        command_handler.onDisconnect(it->second.client);
+        connections.erase(it);
+    }
+    close(fd);
+}
+
+void IoUringBackend::run(const bool& running, std::chrono::milliseconds interval, const Tick& tick) {
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(interval);
+    tick_timeout.tv_sec = seconds.count();
+    tick_timeout.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(interval - seconds).count();
+    armAccept();
+    armTimer();
+
+    while (running) {
+        submitAndWait(1);
+
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            io_uring_cqe cqe = cqes[head & *cq_mask];
+            ++head;
+
+            int fd = static_cast<int>(cqe.user_data & 0xFFFFFFFFu);
+            switch (static_cast<Op>(cqe.user_data >> 32)) {
+                case Op::Accept: handleAccept(cqe); break;
+                case Op::Recv:   handleRecv(fd, cqe); break;
+                case Op::Send:   handleSend(fd, cqe); break;
+                case Op::Provide:
+                    if (cqe.res < 0) {
+                        log("Failed to return receive buffer to the kernel");
+                    }
+                    break;
+                case Op::Probe:  break;
+                case Op::Timer:
+                    tick();
+                    armTimer();
+                    break;
+            }
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+        // Every reply produced by this batch of completions goes out with the
+        // next io_uring_enter call instead of one send() per request.
+        for (int fd : ready_to_send) {
+            auto it = connections.find(fd);
+            if (it == connections.end()) {
+                continue;
+            }
+            Connection& conn = it->second;
+            bool has_output = !conn.pending.empty() || conn.inflight_offset < conn.inflight.size();
+            if (!conn.sending && !conn.closing && has_output) {
+                queueSend(fd, conn);
+            }
+        }
+        ready_to_send.clear();
+    }
+}
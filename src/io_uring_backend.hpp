@@ -0,0 +1,116 @@
+#ifndef IO_URING_BACKEND_HPP
+#define IO_URING_BACKEND_HPP
+
+#include "command_handler.hpp"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <linux/io_uring.h>
+
+// Single-threaded io_uring event loop used in place of the thread-per-client
+// path. Accepts and receives with multishot requests backed by a provided
+// buffer ring (or classic provided buffers on kernels where the ring is
+// unusable), and submits all replies produced by one batch of completions
+// with a single io_uring_enter call.
+class IoUringBackend {
+public:
+    using Logger = std::function<void(const std::string&)>;
+    using Tick = std::function<void()>;
+
+    IoUringBackend(int server_fd, CommandHandler& handler, Logger logger);
+    ~IoUringBackend();
+
+    IoUringBackend(const IoUringBackend&) = delete;
+    IoUringBackend& operator=(const IoUringBackend&) = delete;
+
+    // Serves clients until running is cleared. tick is called on the loop
+    // thread every interval, so periodic work that may push to clients,
+    // such as active expiry, never touches connections concurrently.
+    void run(const bool& running, std::chrono::milliseconds interval, const Tick& tick);
+
+private:
+    enum class Op : uint8_t { Accept = 1, Recv = 2, Send = 3, Provide = 4, Probe = 5, Timer = 6 };
+
+    struct Connection {
+        std::string inflight;   // Reply bytes owned by the kernel until the send completes
+        size_t inflight_offset = 0;
+        std::string pending;    // Replies queued while a send is in flight
+        std::string input;      // Received bytes not yet forming a complete command
+        RESPParser::ParseState parse_state;  // Progress through the command at the front of input
+        std::string pushes;     // Pushes raised by the running command; follow its reply
+        bool executing = false;
+        bool sending = false;
+        bool receiving = true;  // Multishot recv still armed; the fd must stay open
+        bool closing = false;
+        ClientState client;
+    };
+
+    static constexpr unsigned RING_ENTRIES = 256;
+    static constexpr unsigned BUFFER_COUNT = 256;
+    static constexpr unsigned BUFFER_SIZE = 4096;
+    static constexpr uint16_t BUFFER_GROUP = 0;
+
+    int server_fd;
+    CommandHandler& command_handler;
+    Logger log;
+
+    int ring_fd = -1;
+    void* sq_ring_ptr = nullptr;
+    size_t sq_ring_size = 0;
+    void* cq_ring_ptr = nullptr;
+    size_t cq_ring_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_entries = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    unsigned sqe_tail = 0;
+    unsigned to_submit = 0;
+
+    io_uring_buf_ring* buf_ring = nullptr;
+    size_t buf_ring_size = 0;
+    bool use_buf_ring = false;
+    std::vector<char> buffers;
+
+    __kernel_timespec tick_timeout{};   // Read by the kernel when the timer is armed
+
+    std::unordered_map<int, Connection> connections;
+    std::vector<int> ready_to_send;
+
+    void releaseResources();
+    void setupRing();
+    void setupBuffers();
+    bool setupBufferRing();
+    bool probeBufferRing();
+    void probeMultishot();
+    io_uring_cqe waitCqe();
+    io_uring_sqe* getSqe();
+    void submitAndWait(unsigned wait_nr);
+    void recycleBuffer(uint16_t bid);
+
+    void armAccept();
+    void armRecv(int fd);
+    void armTimer();
+    void queueSend(int fd, Connection& conn);
+
+    void handleAccept(const io_uring_cqe& cqe);
+    void handleRecv(int fd, const io_uring_cqe& cqe);
+    void handleSend(int fd, const io_uring_cqe& cqe);
+    void failConnection(int fd, Connection& conn);
+    void closeConnection(int fd);
+
+    static uint64_t encode(Op op, int fd);
+};
+
+#endif // IO_URING_BACKEND_HPP
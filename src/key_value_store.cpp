@@ -1,5 +1,6 @@
 #include "key_value_store.hpp"
 #include "rdb_reader.hpp"
+#include <algorithm>
 #include <fstream>
 
 bool KeyValueStore::isExpired(const ValueWithExpiry& entry) const {
@@ -9,15 +10,33 @@ bool KeyValueStore::isExpired(const ValueWithExpiry& entry) const {
     return std::chrono::steady_clock::now() > *entry.expiry;
 }
 
-void KeyValueStore::set(const std::string& key, const std::string& value, 
-                       std::optional<std::chrono::milliseconds> expiry) {
+size_t KeyValueStore::removalStripe(const std::string& key) {
+    return std::hash<std::string>{}(key) % REMOVAL_STRIPES;
+}
+
+size_t KeyValueStore::entrySize(const std::string& key, const ValueWithExpiry& entry) {
+    // Rough per-entry overhead for the node, hash slot and string headers.
+    constexpr size_t ENTRY_OVERHEAD = 64;
+    return key.size() + entry.value.size() + ENTRY_OVERHEAD;
+}
+
+void KeyValueStore::eraseEntry(std::unordered_map<std::string, ValueWithExpiry>::iterator it) {
+    noteWrite(it->first);
+    if (slot_of) {
+        slot_keys[slot_of(it->first)].erase(&it->first);
+    }
+    removal_versions[removalStripe(it->first)] = ++next_version;
+    used_memory.fetch_sub(entrySize(it->first, it->second), std::memory_order_relaxed);
+    store.erase(it);
+}
+
+void KeyValueStore::setUnlocked(const std::string& key, const std::string& value,
+                                std::optional<std::chrono::milliseconds> expiry) {
     if (key.empty()) {
         throw std::invalid_argument("Key cannot be empty");
     }
 
-    std::lock_guard<std::mutex> lock(mutex);
-    
-    ValueWithExpiry entry{value, std::nullopt};
+    ValueWithExpiry entry{value, std::nullopt, ++next_version};
     if (expiry) {
         if (expiry->count() < 0) {
             throw std::invalid_argument("Expiry time cannot be negative");
@@ -25,29 +44,158 @@ void KeyValueStore::set(const std::string& key, const std::string& value,
         entry.expiry = std::chrono::steady_clock::now() + *expiry;
     }
     
-    store[key] = std::move(entry);
+    used_memory.fetch_add(entrySize(key, entry), std::memory_order_relaxed);
+    auto [it, inserted] = store.try_emplace(key);
+    if (!inserted) {
+        used_memory.fetch_sub(entrySize(key, it->second), std::memory_order_relaxed);
+    } else if (slot_of) {
+        slot_keys[slot_of(key)].insert(&it->first);
+    }
+    it->second = std::move(entry);
+    noteWrite(key);
 }
 
-std::optional<std::string> KeyValueStore::get(const std::string& key) {
+void KeyValueStore::updateUnlocked(const std::string& key, const std::string& value) {
+    auto it = store.find(key);
+    if (it == store.end() || isExpired(it->second)) {
+        setUnlocked(key, value, std::nullopt);
+        return;
+    }
+
+    used_memory.fetch_sub(entrySize(key, it->second), std::memory_order_relaxed);
+    it->second.value = value;
+    it->second.version = ++next_version;
+    used_memory.fetch_add(entrySize(key, it->second), std::memory_order_relaxed);
+    noteWrite(key);
+}
+
+std::optional<std::string> KeyValueStore::getUnlocked(const std::string& key) {
     if (key.empty()) {
         return std::nullopt;
     }
 
-    std::lock_guard<std::mutex> lock(mutex);
-    
     auto it = store.find(key);
     if (it == store.end()) {
         return std::nullopt;
     }
     
     if (isExpired(it->second)) {
-        store.erase(it);
+        eraseEntry(it);
         return std::nullopt;
     }
     
     return it->second.value;
 }
 
+bool KeyValueStore::removeUnlocked(const std::string& key) {
+    auto it = store.find(key);
+    if (it == store.end()) {
+        return false;
+    }
+    eraseEntry(it);
+    return true;
+}
+
+void KeyValueStore::noteWrite(const std::string& key) {
+    if (write_listener && listener_active()) {
+        written_keys.push_back(key);
+    }
+}
+
+void KeyValueStore::notifyWrites(std::unique_lock<std::mutex>& lock) {
+    if (!lock.owns_lock() || written_keys.empty()) {
+        return;
+    }
+    std::vector<std::string> keys;
+    keys.swap(written_keys);
+    lock.unlock();
+    for (const auto& key : keys) {
+        write_listener(key);
+    }
+}
+
+uint64_t KeyValueStore::versionUnlocked(const std::string& key) const {
+    auto it = store.find(key);
+    if (it == store.end()) {
+        return removal_versions[removalStripe(key)];
+    }
+    if (isExpired(it->second)) {
+        // Not erased yet; differs from the live version and from every
+        // removal stamp, which come from the same counter.
+        return ~it->second.version;
+    }
+    return it->second.version;
+}
+
+bool KeyValueStore::existsUnlocked(const std::string& key) const {
+    auto it = store.find(key);
+    return it != store.end() && !isExpired(it->second);
+}
+
+bool KeyValueStore::exists(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return existsUnlocked(key);
+}
+
+std::optional<std::chrono::milliseconds> KeyValueStore::ttlUnlocked(const std::string& key) const {
+    auto it = store.find(key);
+    if (it == store.end() || !it->second.expiry || isExpired(it->second)) {
+        return std::nullopt;
+    }
+    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(*it->second.expiry - std::chrono::steady_clock::now());
+    return std::max(remaining, std::chrono::milliseconds(1));
+}
+
+void KeyValueStore::set(const std::string& key, const std::string& value, 
+                       std::optional<std::chrono::milliseconds> expiry) {
+    std::unique_lock<std::mutex> lock(mutex);
+    setUnlocked(key, value, expiry);
+    notifyWrites(lock);
+}
+
+std::optional<std::string> KeyValueStore::get(const std::string& key) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto value = getUnlocked(key);
+    notifyWrites(lock);
+    return value;
+}
+
+void KeyValueStore::enableSlotIndex(SlotFunction slot_function, int slots) {
+    std::lock_guard<std::mutex> lock(mutex);
+    slot_of = slot_function;
+    slot_keys.assign(static_cast<size_t>(slots), {});
+    for (const auto& [key, value] : store) {
+        slot_keys[slot_of(key)].insert(&key);
+    }
+}
+
+size_t KeyValueStore::countKeysInSlot(int slot) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return slot_of ? slot_keys[slot].size() : 0;
+}
+
+std::vector<std::string> KeyValueStore::getKeysInSlot(int slot, size_t limit) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> keys;
+    if (!slot_of) {
+        return keys;
+    }
+    for (const std::string* key : slot_keys[slot]) {
+        if (keys.size() >= limit) {
+            break;
+        }
+        if (!isExpired(store.find(*key)->second)) {
+            keys.push_back(*key);
+        }
+    }
+    return keys;
+}
+
+uint64_t KeyValueStore::version(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return versionUnlocked(key);
+}
+
 void KeyValueStore::loadFromRDB(const std::string& dir, const std::string& filename) {
     if (dir.empty() || filename.empty()) {
         throw std::invalid_argument("Directory and filename cannot be empty");
@@ -76,14 +224,15 @@ void KeyValueStore::loadFromRDB(const std::string& dir, const std::string& filen
 
 // Add a cleanup method to remove expired entries
 void KeyValueStore::cleanup() {
-    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_lock<std::mutex> lock(mutex);
     for (auto it = store.begin(); it != store.end();) {
+        auto next = std::next(it);
         if (isExpired(it->second)) {
-            it = store.erase(it);
-        } else {
-            ++it;
+            eraseEntry(it);
         }
+        it = next;
     }
+    notifyWrites(lock);
 }
 
 // Add a method to remove a key explicitly
@@ -92,8 +241,37 @@ bool KeyValueStore::remove(const std::string& key) {
         return false;
     }
 
-    std::lock_guard<std::mutex> lock(mutex);
-    return store.erase(key) > 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    bool removed = removeUnlocked(key);
+    notifyWrites(lock);
+    return removed;
+}
+
+size_t KeyValueStore::activeExpireCycle(size_t max_checks) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (store.empty()) {
+        return 0;
+    }
+
+    // Walk buckets rather than iterators so the cursor survives rehashing.
+    std::vector<std::string> expired;
+    size_t checked = 0;
+    size_t buckets = store.bucket_count();
+    for (size_t visited = 0; visited < buckets && checked < max_checks; ++visited) {
+        size_t bucket = expire_cursor++ % buckets;
+        for (auto it = store.begin(bucket); it != store.end(bucket); ++it) {
+            ++checked;
+            if (isExpired(it->second)) {
+                expired.push_back(it->first);
+            }
+        }
+    }
+
+    for (const auto& key : expired) {
+        eraseEntry(store.find(key));
+    }
+    notifyWrites(lock);
+    return expired.size();
 }
 
 std::vector<std::string> KeyValueStore::getKeys() const {
@@ -1,33 +1,136 @@
 #ifndef KEY_VALUE_STORE_HPP
 #define KEY_VALUE_STORE_HPP
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <mutex>
 #include <optional>
 #include <chrono>
+#include <functional>
 #include <vector>
 
 class KeyValueStore {
+public:
+    using WriteListener = std::function<void(const std::string& key)>;
+    // Whether the write listener currently wants keys; checked on every write.
+    using ListenerActive = std::function<bool()>;
+    using SlotFunction = int (*)(std::string_view key);
+
 private:
     struct ValueWithExpiry {
         std::string value;
         std::optional<std::chrono::steady_clock::time_point> expiry;
+        uint64_t version = 0;
     };
     
     std::unordered_map<std::string, ValueWithExpiry> store;
     mutable std::mutex mutex;;
+    std::atomic<size_t> used_memory{0};
+    size_t expire_cursor = 0;
+    uint64_t next_version = 0;
+    // Stamp of the latest erase of any key hashing to each stripe; only
+    // ever raised, so a stripe never reports an older removal.
+    static constexpr size_t REMOVAL_STRIPES = 4096;
+    std::array<uint64_t, REMOVAL_STRIPES> removal_versions{};
+    WriteListener write_listener;
+    ListenerActive listener_active;
+    std::vector<std::string> written_keys;   // Awaiting write_listener; guarded by mutex
+    SlotFunction slot_of = nullptr;
+    // Keys of each hash slot, pointing at the map's own keys; empty unless
+    // the slot index is enabled.
+    std::vector<std::unordered_set<const std::string*>> slot_keys;
 
     bool isExpired(const ValueWithExpiry& entry) const;
+    static size_t removalStripe(const std::string& key);
+    static size_t entrySize(const std::string& key, const ValueWithExpiry& entry);
+    // Erases and reports the key, whether removed or expired.
+    void eraseEntry(std::unordered_map<std::string, ValueWithExpiry>::iterator it);
+
+    // Callers must hold mutex.
+    void setUnlocked(const std::string& key, const std::string& value,
+                     std::optional<std::chrono::milliseconds> expiry);
+    void updateUnlocked(const std::string& key, const std::string& value);
+    std::optional<std::string> getUnlocked(const std::string& key);
+    bool removeUnlocked(const std::string& key);
+    uint64_t versionUnlocked(const std::string& key) const;
+    bool existsUnlocked(const std::string& key) const;
+    std::optional<std::chrono::milliseconds> ttlUnlocked(const std::string& key) const;
+    void noteWrite(const std::string& key);
+    // Releases lock, then reports the keys written while it was held.
+    void notifyWrites(std::unique_lock<std::mutex>& lock);
 
 public:
+    // Holds the store lock for its whole lifetime so a batch of operations,
+    // such as a MULTI/EXEC block, costs a single acquisition.
+    class Transaction {
+    public:
+        explicit Transaction(KeyValueStore& store) : kv(store), lock(store.mutex) {}
+        ~Transaction() { kv.notifyWrites(lock); }
+
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+        void set(const std::string& key, const std::string& value,
+                 std::optional<std::chrono::milliseconds> expiry = std::nullopt) {
+            kv.setUnlocked(key, value, expiry);
+        }
+        // Replaces the value of key but keeps its TTL, as in-place
+        // modifications such as SETBIT do.
+        void update(const std::string& key, const std::string& value) { kv.updateUnlocked(key, value); }
+        std::optional<std::string> get(const std::string& key) { return kv.getUnlocked(key); }
+        bool remove(const std::string& key) { return kv.removeUnlocked(key); }
+        uint64_t version(const std::string& key) const { return kv.versionUnlocked(key); }
+        bool exists(const std::string& key) const { return kv.existsUnlocked(key); }
+        // Remaining time to live; std::nullopt for missing or persistent keys.
+        std::optional<std::chrono::milliseconds> ttl(const std::string& key) const { return kv.ttlUnlocked(key); }
+
+    private:
+        KeyValueStore& kv;
+        std::unique_lock<std::mutex> lock;
+    };
+
+    Transaction transaction() { return Transaction(*this); }
+
+    // Invoked with every key written through set, update or remove, or
+    // erased on expiry, after the store lock is released. Writes made while
+    // active() is false are not recorded at all. Install before serving
+    // clients.
+    void setWriteListener(WriteListener listener, ListenerActive active) {
+        write_listener = std::move(listener);
+        listener_active = std::move(active);
+    }
+
     void set(const std::string& key, const std::string& value, 
              std::optional<std::chrono::milliseconds> expiry = std::nullopt);
     std::optional<std::string> get(const std::string& key);
     std::vector<std::string> getKeys() const;
+    // Groups keys by slot_function(key), in [0, slots), so the cluster
+    // commands that count or list a slot's keys need not scan the keyspace.
+    void enableSlotIndex(SlotFunction slot_function, int slots);
+    // Keys in slot, including expired ones not erased yet.
+    size_t countKeysInSlot(int slot) const;
+    // Up to limit live keys in slot.
+    std::vector<std::string> getKeysInSlot(int slot, size_t limit) const;
     void loadFromRDB(const std::string& dir, const std::string& filename);
     void cleanup();
     bool remove(const std::string& key);
+    // Changes on every write to key, including its removal or expiry. WATCH
+    // compares these to detect concurrent modification. A missing key
+    // reports the stamp of the latest removal in its hash stripe, so a key
+    // that is created and deleted again is still noticed; an unrelated key
+    // only causes a spurious change when it shares the stripe.
+    uint64_t version(const std::string& key) const;
+    bool exists(const std::string& key) const;
+    // Samples up to max_checks keys, resuming where the previous call stopped,
+    // and erases the expired ones. Returns the number of keys erased.
+    size_t activeExpireCycle(size_t max_checks);
+    // Approximate bytes held by keys and values; read without the store lock.
+    size_t usedMemory() const { return used_memory.load(std::memory_order_relaxed); }
 };
 
 #endif // KEY_VALUE_STORE_HPP
\ No newline at end of file
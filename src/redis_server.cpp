@@ -1,15 +1,96 @@
 #include "redis_server.hpp"
+#include "io_uring_backend.hpp"
+#include "resp_client.hpp"
+#include <cerrno>
 #include <iostream>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <stdexcept>
+#include <map>
+#include <memory>
+
+namespace {
+
+// Invalidation pushes for a client served by its own thread. Writers on
+// other threads only queue them and wake that thread, which sends them
+// after the replies it has computed so far: a push never overtakes a reply
+// read before the write, and a client that stopped reading cannot block a
+// writer.
+struct PushQueue {
+    std::mutex mutex;
+    std::string pending;
+    bool open = true;
+    int wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    PushQueue() {
+        if (wake_fd < 0) {
+            throw std::runtime_error("Failed to create eventfd");
+        }
+    }
+    ~PushQueue() { ::close(wake_fd); }
+
+    PushQueue(const PushQueue&) = delete;
+    PushQueue& operator=(const PushQueue&) = delete;
+
+    void push(const std::string& message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!open) {
+            return;
+        }
+        pending += message;
+        uint64_t one = 1;
+        (void)!::write(wake_fd, &one, sizeof(one));
+    }
+
+    std::string take() {
+        uint64_t count;
+        (void)!::read(wake_fd, &count, sizeof(count));
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string messages;
+        messages.swap(pending);
+        return messages;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        open = false;
+        pending.clear();
+    }
+};
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
 
 RedisServer::RedisServer(int argc, char** argv) : 
     server_fd(-1), 
     running(true),
-    command_handler(kv_store, config_manager) {
+    cluster_state(config_manager),
+    command_handler(kv_store, config_manager, client_tracking, cluster_state) {
     config_manager.parseArgs(argc, argv);
+    if (config_manager.snapshot()->cluster_enabled) {
+        kv_store.enableSlotIndex(ClusterState::keyHashSlot, ClusterState::SLOTS);
+    }
+    kv_store.setWriteListener(
+        [this](const std::string& key) { client_tracking.invalidate(key); },
+        [this]() { return client_tracking.active(); });
     setupServerSocket();
     bindSocket();
     startListening();
@@ -35,12 +116,12 @@ void RedisServer::setupServerSocket() {
 
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(PORT);
+    server_addr.sin_port = htons(static_cast<uint16_t>(config_manager.snapshot()->port));
 }
 
 void RedisServer::bindSocket() {
     if (bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) != 0) {
-        throw std::runtime_error("Failed to bind to port 6379");
+        throw std::runtime_error("Failed to bind to port " + std::to_string(config_manager.snapshot()->port));
     }
 }
 
@@ -57,35 +138,64 @@ void RedisServer::logMessage(const std::string& message) {
 
 void RedisServer::handleClient(int client_fd) {
     char buffer[BUFFER_SIZE];
-    
+    std::string input;
+    RESPParser::ParseState parse_state;
+    ClientState client;
+    auto pushes = std::make_shared<PushQueue>();
+    command_handler.onConnect(client, [pushes](const std::string& message) {
+        pushes->push(message);
+    });
+
+    pollfd fds[2] = {{client_fd, POLLIN, 0}, {pushes->wake_fd, POLLIN, 0}};
     while (running) {
-        ssize_t bytes_read = recv(client_fd, buffer, BUFFER_SIZE - 1, 0);
-        
-        if (bytes_read <= 0) {
-            if (bytes_read == 0) {
-                logMessage("Client disconnected");
-            } else {
-                logMessage("Error reading from client");
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            logMessage("Error polling client");
             break;
         }
 
-        buffer[bytes_read] = '\0';
-        
-        try {
-            RESPParser::Command cmd = RESPParser::parseCommand(buffer);
-            std::string response = command_handler.handleCommand(cmd);
-            
-            if (send(client_fd, response.c_str(), response.length(), 0) < 0) {
-                logMessage("Error sending response");
+        std::string response;
+        if (fds[0].revents != 0) {
+            ssize_t bytes_read = recv(client_fd, buffer, BUFFER_SIZE, 0);
+
+            if (bytes_read <= 0) {
+                if (bytes_read == 0) {
+                    logMessage("Client disconnected");
+                } else {
+                    logMessage("Error reading from client");
+                }
+                break;
+            }
+
+            input.append(buffer, bytes_read);
+
+            try {
+                // A read may end mid-command or carry several pipelined ones;
+                // answer every complete command with a single send.
+                size_t offset = 0;
+                size_t consumed = 0;
+                while (auto cmd = RESPParser::tryParseCommand(std::string_view(input).substr(offset), consumed, parse_state)) {
+                    response += command_handler.handleCommand(*cmd, client);
+                    offset += consumed;
+                }
+                input.erase(0, offset);
+            } catch (const std::exception& e) {
+                logMessage("Error processing command: " + std::string(e.what()));
                 break;
             }
-        } catch (const std::exception& e) {
-            logMessage("Error processing command: " + std::string(e.what()));
+        }
+
+        response += pushes->take();
+        if (!response.empty() && !sendAll(client_fd, response)) {
+            logMessage("Error sending response");
             break;
         }
     }
 
+    command_handler.onDisconnect(client);
+    pushes->close();
     close(client_fd);
 }
 
@@ -102,23 +212,123 @@ void RedisServer::acceptClients() {
         }
 
         logMessage("Client connected");
-        
-        client_threads.emplace_back([this, client_fd]() {
+        // Replies and pushes are small writes; do not hold them back for
+        // the peer's delayed ACK.
+        int nodelay = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        reapClientThreads();
+        ClientThread& entry = client_threads.emplace_back();
+        entry.thread = std::thread([this, client_fd, &entry]() {
             handleClient(client_fd);
+            entry.done.store(true, std::memory_order_release);
+        });
+    }
+}
+
+void RedisServer::reapClientThreads() {
+    for (auto it = client_threads.begin(); it != client_threads.end();) {
+        if (it->done.load(std::memory_order_acquire)) {
+            it->thread.join();
+            it = client_threads.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool RedisServer::runIoUring() {
+    try {
+        IoUringBackend backend(server_fd, command_handler, [this](const std::string& message) {
+            logMessage(message);
         });
+        logMessage("Using io_uring I/O backend");
+        backend.run(running, ACTIVE_EXPIRE_INTERVAL, [this]() { activeExpireCycle(); });
+        return true;
+    } catch (const std::exception& e) {
+        logMessage("io_uring backend unavailable, falling back to threads: " + std::string(e.what()));
+        return false;
+    }
+}
+
+void RedisServer::activeExpireCycle() {
+    int effort = config_manager.snapshot()->active_expire_effort;
+    kv_store.activeExpireCycle(static_cast<size_t>(ACTIVE_EXPIRE_KEYS_PER_LOOP * effort));
+}
+
+void RedisServer::activeExpireLoop() {
+    while (running) {
+        std::this_thread::sleep_for(ACTIVE_EXPIRE_INTERVAL);
+        activeExpireCycle();
+    }
+}
+
+void RedisServer::clusterGossipLoop() {
+    // Gossip travels as CLUSTER GOSSIP over the peers' client port; the reply
+    // carries the peer's view back, so one exchange updates both sides.
+    // Connections are kept per peer address and only reopened after an error.
+    std::map<std::string, std::unique_ptr<RESPClient>> peers;
+    while (running) {
+        std::this_thread::sleep_for(CLUSTER_GOSSIP_INTERVAL);
+        auto timeout = std::chrono::milliseconds(
+            std::min<uint64_t>(config_manager.snapshot()->cluster_node_timeout, 1000));
+        for (const auto& target : cluster_state.gossipTargets()) {
+            auto& peer = peers[target.ip + ":" + std::to_string(target.port)];
+            try {
+                std::vector<std::string> request = {"CLUSTER", "GOSSIP"};
+                for (auto& field : cluster_state.gossipMessage()) {
+                    request.push_back(std::move(field));
+                }
+                if (!peer) {
+                    peer = std::make_unique<RESPClient>(target.ip, target.port, timeout);
+                }
+                RESPClient::Reply reply = peer->call(request);
+                if (reply.type != RESPClient::Reply::Type::Array) {
+                    continue;
+                }
+                std::vector<std::string> fields;
+                for (const auto& element : reply.elements) {
+                    fields.push_back(element.str);
+                }
+                cluster_state.handleGossip(fields);
+            } catch (const std::exception&) {
+                // Reconnect next time. Unreachable peers are reported through
+                // CLUSTER NODES once they miss the node timeout.
+                peer.reset();
+            }
+        }
     }
 }
 
 void RedisServer::start() {
     logMessage("Server starting... Waiting for clients to connect...");
+    if (config_manager.snapshot()->cluster_enabled) {
+        logMessage("Cluster mode enabled, node id " + cluster_state.myId());
+        cluster_thread = std::thread([this]() { clusterGossipLoop(); });
+    }
+    // Not read inline: a snapshot temporary would live as long as the
+    // io_uring loop and stall every CONFIG SET waiting for its readers.
+    bool use_io_uring = config_manager.snapshot()->io_backend == "io_uring";
+    // The io_uring loop expires keys itself: expiry pushes invalidations,
+    // which its connections only accept from the loop thread.
+    if (use_io_uring && runIoUring()) {
+        return;
+    }
+    expire_thread = std::thread([this]() { activeExpireLoop(); });
     acceptClients();
 }
 
 void RedisServer::stop() {
     running = false;
-    for (auto& thread : client_threads) {
-        if (thread.joinable()) {
-            thread.join();
+    if (expire_thread.joinable()) {
+        expire_thread.join();
+    }
+    if (cluster_thread.joinable()) {
+        cluster_thread.join();
+    }
+    for (auto& entry : client_threads) {
+        if (entry.thread.joinable()) {
+            entry.thread.join();
         }
     }
     client_threads.clear();
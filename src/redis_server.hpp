@@ -4,6 +4,11 @@
 #include "key_value_store.hpp"
 #include "config_manager.hpp"
 #include "command_handler.hpp"
+#include "client_tracking.hpp"
+#include "cluster.hpp"
+#include <atomic>
+#include <chrono>
+#include <list>
 #include <vector>
 #include <thread>
 #include <mutex>
@@ -13,15 +18,26 @@ class RedisServer {
 private:
     int server_fd;
     struct sockaddr_in server_addr;
-    const int PORT = 6379;
     const int CONNECTION_BACKLOG = 5;
-    const int BUFFER_SIZE = 1024;
+    const int BUFFER_SIZE = 16384;
+    const int ACTIVE_EXPIRE_KEYS_PER_LOOP = 20;
+    const std::chrono::milliseconds ACTIVE_EXPIRE_INTERVAL{100};
+    const std::chrono::milliseconds CLUSTER_GOSSIP_INTERVAL{100};
     
-    std::vector<std::thread> client_threads;
+    struct ClientThread {
+        std::thread thread;
+        std::atomic<bool> done{false};   // Set as handleClient returns
+    };
+
+    std::list<ClientThread> client_threads;   // Owned by the accept loop
+    std::thread expire_thread;
+    std::thread cluster_thread;
     std::mutex cout_mutex;
     bool running;
     KeyValueStore kv_store;
     ConfigManager config_manager;
+    ClientTracking client_tracking;
+    ClusterState cluster_state;
     CommandHandler command_handler;
 
     void setupServerSocket();
@@ -30,6 +46,12 @@ private:
     void logMessage(const std::string& message);
     void handleClient(int client_fd);
     void acceptClients();
+    // Joins client threads whose connection has ended.
+    void reapClientThreads();
+    void activeExpireCycle();
+    void activeExpireLoop();
+    void clusterGossipLoop();
+    bool runIoUring();
 
 public:
     RedisServer(int argc, char** argv);
@@ -0,0 +1,172 @@
+#include "resp_client.hpp"
+#include "resp_parser.hpp"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+long long parseNumber(const std::string& text) {
+    long long value = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || ptr != text.data() + text.size() || text.empty()) {
+        throw std::runtime_error("Malformed reply");
+    }
+    return value;
+}
+
+} // namespace
+
+RESPClient::RESPClient(const std::string& host, int port, std::chrono::milliseconds timeout) : fd(-1) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0 || !result) {
+        throw std::runtime_error("Failed to resolve " + host);
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        freeaddrinfo(result);
+        throw std::runtime_error("Failed to create socket");
+    }
+
+    // Non-blocking connect so an unreachable node costs at most timeout.
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int rc = connect(fd, result->ai_addr, result->ai_addrlen);
+    freeaddrinfo(result);
+    if (rc != 0 && errno == EINPROGRESS) {
+        pollfd pfd{fd, POLLOUT, 0};
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (poll(&pfd, 1, static_cast<int>(timeout.count())) == 1 &&
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0) {
+            rc = 0;
+        }
+    }
+    if (rc != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to connect to " + host + ":" + std::to_string(port));
+    }
+    fcntl(fd, F_SETFL, flags);
+
+    timeval tv{};
+    tv.tv_sec = timeout.count() / 1000;
+    tv.tv_usec = (timeout.count() % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+RESPClient::~RESPClient() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+RESPClient::Reply RESPClient::call(const std::vector<std::string>& args) {
+    return std::move(callPipelined({args}).front());
+}
+
+std::vector<RESPClient::Reply> RESPClient::callPipelined(const std::vector<std::vector<std::string>>& commands) {
+    std::string request;
+    for (const auto& args : commands) {
+        request += RESPParser::createArray(args);
+    }
+    size_t sent = 0;
+    while (sent < request.size()) {
+        ssize_t n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            throw std::runtime_error("Failed to send request");
+        }
+        sent += static_cast<size_t>(n);
+    }
+
+    std::vector<Reply> replies;
+    replies.reserve(commands.size());
+    for (size_t i = 0; i < commands.size(); ++i) {
+        replies.push_back(readReply());
+    }
+    return replies;
+}
+
+void RESPClient::fill() {
+    if (offset > 0) {
+        buffer.erase(0, offset);
+        offset = 0;
+    }
+    char chunk[16384];
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+        throw std::runtime_error(n == 0 ? "Connection closed by peer" : "Timed out waiting for reply");
+    }
+    buffer.append(chunk, static_cast<size_t>(n));
+}
+
+std::string RESPClient::readLine() {
+    size_t end;
+    while ((end = buffer.find("\r\n", offset)) == std::string::npos) {
+        fill();
+    }
+    std::string line = buffer.substr(offset, end - offset);
+    offset = end + 2;
+    return line;
+}
+
+RESPClient::Reply RESPClient::readReply() {
+    std::string line = readLine();
+    if (line.empty()) {
+        throw std::runtime_error("Malformed reply");
+    }
+
+    Reply reply;
+    std::string payload = line.substr(1);
+    switch (line[0]) {
+        case '+':
+            reply.type = Reply::Type::Simple;
+            reply.str = payload;
+            return reply;
+        case '-':
+            reply.type = Reply::Type::Error;
+            reply.str = payload;
+            return reply;
+        case ':':
+            reply.type = Reply::Type::Integer;
+            reply.integer = parseNumber(payload);
+            return reply;
+        case '$': {
+            long long length = parseNumber(payload);
+            if (length < 0) {
+                return reply;
+            }
+            while (buffer.size() - offset < static_cast<size_t>(length) + 2) {
+                fill();
+            }
+            reply.type = Reply::Type::Bulk;
+            reply.str = buffer.substr(offset, static_cast<size_t>(length));
+            offset += static_cast<size_t>(length) + 2;
+            return reply;
+        }
+        case '*': {
+            long long count = parseNumber(payload);
+            if (count < 0) {
+                return reply;
+            }
+            reply.type = Reply::Type::Array;
+            for (long long i = 0; i < count; ++i) {
+                reply.elements.push_back(readReply());
+            }
+            return reply;
+        }
+        default:
+            throw std::runtime_error("Unsupported reply type");
+    }
+}
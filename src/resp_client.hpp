@@ -0,0 +1,44 @@
+#ifndef RESP_CLIENT_HPP
+#define RESP_CLIENT_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Minimal blocking RESP client for node-to-node traffic (cluster gossip and
+// MIGRATE). Every operation is bounded by the timeout given at construction;
+// failures throw std::runtime_error.
+class RESPClient {
+public:
+    struct Reply {
+        enum class Type { Simple, Error, Integer, Bulk, Null, Array };
+        Type type = Type::Null;
+        std::string str;            // Simple, Error and Bulk
+        long long integer = 0;
+        std::vector<Reply> elements;
+
+        bool isError() const { return type == Type::Error; }
+    };
+
+    RESPClient(const std::string& host, int port, std::chrono::milliseconds timeout);
+    ~RESPClient();
+
+    RESPClient(const RESPClient&) = delete;
+    RESPClient& operator=(const RESPClient&) = delete;
+
+    Reply call(const std::vector<std::string>& args);
+    // Sends every command before reading any reply, saving a round trip per
+    // command; replies are returned in order.
+    std::vector<Reply> callPipelined(const std::vector<std::vector<std::string>>& commands);
+
+private:
+    int fd;
+    std::string buffer;
+    size_t offset = 0;
+
+    void fill();
+    std::string readLine();
+    Reply readReply();
+};
+
+#endif // RESP_CLIENT_HPP
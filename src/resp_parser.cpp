@@ -1,31 +1,92 @@
 #include "resp_parser.hpp"
 #include <algorithm>
+#include <charconv>
 #include <stdexcept>
 
-RESPParser::Command RESPParser::parseCommand(const std::string& input) {
-    Command cmd;
-    std::istringstream iss(input);
-    std::string line;
+namespace {
 
-    std::getline(iss, line, '\n');
-    if (line[0] != '*') {
-        throw std::runtime_error("Invalid RESP array");
+// Reads the "<prefix><integer>\r\n" header at pos; nullopt if incomplete.
+std::optional<long long> readHeader(std::string_view input, size_t& pos, char prefix) {
+    size_t end = input.find("\r\n", pos);
+    if (end == std::string_view::npos) {
+        return std::nullopt;
+    }
+    if (input[pos] != prefix || end == pos + 1) {
+        throw std::runtime_error(prefix == '*' ? "Invalid RESP array" : "Invalid bulk string");
     }
+    long long value = 0;
+    auto [ptr, ec] = std::from_chars(input.data() + pos + 1, input.data() + end, value);
+    if (ec != std::errc() || ptr != input.data() + end) {
+        throw std::runtime_error("Invalid RESP length");
+    }
+    pos = end + 2;
+    return value;
+}
 
-    int arrayLen = std::stoi(line.substr(1));
-    if (arrayLen < 1) {
-        throw std::runtime_error("Empty command");
+} // namespace
+
+std::optional<RESPParser::Command> RESPParser::tryParseCommand(std::string_view input, size_t& consumed,
+                                                               ParseState& state) {
+    constexpr long long MAX_ARGS = 1024 * 1024;
+    constexpr long long MAX_BULK_LENGTH = 512LL * 1024 * 1024;
+
+    if (state.count < 0) {
+        size_t pos = 0;
+        if (input.empty()) {
+            return std::nullopt;
+        }
+        auto count = readHeader(input, pos, '*');
+        if (!count) {
+            return std::nullopt;
+        }
+        if (*count < 1 || *count > MAX_ARGS) {
+            throw std::runtime_error("Invalid command length");
+        }
+        state.count = *count;
+        state.pos = pos;
     }
 
-    readBulkString(iss, cmd.name);
-    std::transform(cmd.name.begin(), cmd.name.end(), cmd.name.begin(), ::toupper);
+    // Validate the elements that have not been seen yet, resuming after the
+    // last complete one, without copying anything.
+    while (state.scanned < state.count) {
+        size_t pos = state.pos;
+        if (pos >= input.size()) {
+            return std::nullopt;
+        }
+        auto length = readHeader(input, pos, '$');
+        if (!length) {
+            return std::nullopt;
+        }
+        if (*length < 0 || *length > MAX_BULK_LENGTH) {
+            throw std::runtime_error("Invalid bulk length");
+        }
+        size_t len = static_cast<size_t>(*length);
+        if (input.size() < pos + len + 2) {
+            return std::nullopt;
+        }
+        state.pos = pos + len + 2;
+        ++state.scanned;
+    }
 
-    for (int i = 1; i < arrayLen; i++) {
-        std::string arg;
-        readBulkString(iss, arg);
-        cmd.args.push_back(arg);
+    // The command is complete and valid: copy it out in one pass.
+    Command cmd;
+    cmd.args.reserve(static_cast<size_t>(state.count - 1));
+    size_t pos = 0;
+    readHeader(input, pos, '*');
+    for (long long i = 0; i < state.count; ++i) {
+        size_t len = static_cast<size_t>(*readHeader(input, pos, '$'));
+        std::string value(input.substr(pos, len));
+        pos += len + 2;
+        if (i == 0) {
+            std::transform(value.begin(), value.end(), value.begin(), ::toupper);
+            cmd.name = std::move(value);
+        } else {
+            cmd.args.push_back(std::move(value));
+        }
     }
 
+    consumed = pos;
+    state = ParseState{};
     return cmd;
 }
 
@@ -45,28 +106,45 @@ std::string RESPParser::createNullBulkString() {
     return "$-1\r\n";
 }
 
+std::string RESPParser::createNullArray() {
+    return "*-1\r\n";
+}
+
 std::string RESPParser::createSimpleString(const std::string& str) {
     return "+" + str + "\r\n";
 }
 
-void RESPParser::readBulkString(std::istringstream& iss, std::string& result) {
-    std::string line;
-    
-    std::getline(iss, line, '\n');
-    if (line[0] != '$') {
-        throw std::runtime_error("Invalid bulk string");
-    }
-    
-    int strLen = std::stoi(line.substr(1));
-    if (strLen < 0) {
-        throw std::runtime_error("Null bulk string");
+std::string RESPParser::createError(const std::string& message) {
+    return "-" + message + "\r\n";
+}
+
+std::string RESPParser::createInteger(long long value) {
+    return ":" + std::to_string(value) + "\r\n";
+}
+
+std::string RESPParser::createMap(const std::vector<std::pair<std::string, std::string>>& fields,
+                                  int protocol) {
+    std::string result = protocol >= 3 ? "%" + std::to_string(fields.size()) + "\r\n"
+                                       : "*" + std::to_string(fields.size() * 2) + "\r\n";
+    for (const auto& [key, value] : fields) {
+        result += createBulkString(key);
+        result += value;
     }
+    return result;
+}
 
-    char* buffer = new char[strLen + 1];
-    iss.read(buffer, strLen);
-    buffer[strLen] = '\0';
-    result = std::string(buffer);
-    delete[] buffer;
+std::string RESPParser::createEncodedArray(const std::vector<std::string>& elements) {
+    std::string result = "*" + std::to_string(elements.size()) + "\r\n";
+    for (const auto& element : elements) {
+        result += element;
+    }
+    return result;
+}
 
-    iss.ignore(2);
-}
\ No newline at end of file
+std::string RESPParser::createPush(const std::vector<std::string>& elements) {
+    std::string result = ">" + std::to_string(elements.size()) + "\r\n";
+    for (const auto& element : elements) {
+        result += element;
+    }
+    return result;
+}
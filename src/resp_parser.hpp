@@ -1,9 +1,11 @@
 #ifndef RESP_PARSER_HPP
 #define RESP_PARSER_HPP
 
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
-#include <sstream>
 
 class RESPParser {
 public:
@@ -12,14 +14,37 @@ public:
         std::vector<std::string> args;
     };
 
-    static Command parseCommand(const std::string& input);
+    // Progress through a partially received command, kept by the caller
+    // between reads so each argument is scanned once however many reads
+    // the command spans. Offsets are relative to the command's first byte.
+    struct ParseState {
+        long long count = -1;   // Elements in the command, once its header arrived
+        long long scanned = 0;  // Elements known to be complete
+        size_t pos = 0;         // Offset just past the last complete element
+    };
+
+    // Parses one command from the front of input, which may hold a partial
+    // command or several pipelined ones. Returns std::nullopt and leaves
+    // consumed untouched until a complete command has arrived, recording in
+    // state how far it got; input must then start at the same command on
+    // the next call. Arguments are only copied out once the command is
+    // complete. Throws std::runtime_error on malformed input.
+    static std::optional<Command> tryParseCommand(std::string_view input, size_t& consumed, ParseState& state);
     static std::string createBulkString(const std::string& str);
     static std::string createArray(const std::vector<std::string>& elements);
     static std::string createNullBulkString();
+    static std::string createNullArray();
     static std::string createSimpleString(const std::string& str);
-
-private:
-    static void readBulkString(std::istringstream& iss, std::string& result);
+    static std::string createError(const std::string& message);
+    static std::string createInteger(long long value);
+    // Values must already be RESP encoded. RESP2 clients get the map as a
+    // flat array of alternating keys and values.
+    static std::string createMap(const std::vector<std::pair<std::string, std::string>>& fields,
+                                 int protocol);
+    // Array of mixed element types; elements must already be RESP encoded.
+    static std::string createEncodedArray(const std::vector<std::string>& elements);
+    // RESP3 out-of-band push; elements must already be RESP encoded.
+    static std::string createPush(const std::vector<std::string>& elements);
 };
 
 #endif // RESP_PARSER_HPP
\ No newline at end of file
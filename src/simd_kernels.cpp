@@ -0,0 +1,242 @@
+#include "simd_kernels.hpp"
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_KERNELS_X86 1
+#endif
+
+namespace simd {
+
+namespace {
+
+struct Kernels {
+    uint64_t (*popcount)(const uint8_t*, size_t);
+    void (*maxBytes)(uint8_t*, const uint8_t*, size_t);
+    void (*bitop)(BitOp, uint8_t*, const uint8_t*, size_t);
+};
+
+// ---- Scalar -------------------------------------------------------------
+
+uint64_t popcountScalar(const uint8_t* data, size_t len) {
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        count += __builtin_popcountll(word);
+    }
+    for (; i < len; ++i) {
+        count += __builtin_popcount(data[i]);
+    }
+    return count;
+}
+
+void maxBytesScalar(uint8_t* dst, const uint8_t* src, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        if (src[i] > dst[i]) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+void bitopScalarTail(BitOp op, uint8_t* dst, const uint8_t* src, size_t len) {
+    switch (op) {
+        case BitOp::And: for (size_t i = 0; i < len; ++i) dst[i] &= src[i]; break;
+        case BitOp::Or:  for (size_t i = 0; i < len; ++i) dst[i] |= src[i]; break;
+        case BitOp::Xor: for (size_t i = 0; i < len; ++i) dst[i] ^= src[i]; break;
+    }
+}
+
+void bitopScalar(BitOp op, uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t a, b;
+        std::memcpy(&a, dst + i, 8);
+        std::memcpy(&b, src + i, 8);
+        switch (op) {
+            case BitOp::And: a &= b; break;
+            case BitOp::Or:  a |= b; break;
+            case BitOp::Xor: a ^= b; break;
+        }
+        std::memcpy(dst + i, &a, 8);
+    }
+    bitopScalarTail(op, dst + i, src + i, len - i);
+}
+
+constexpr Kernels SCALAR_KERNELS{popcountScalar, maxBytesScalar, bitopScalar};
+
+#ifdef SIMD_KERNELS_X86
+
+// ---- SSE (SSSE3 for the popcount shuffle, SSE2 otherwise) ----------------
+
+__attribute__((target("ssse3")))
+uint64_t popcountSSE(const uint8_t* data, size_t len) {
+    // Per-nibble lookup table (Mula's pshufb popcount).
+    const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i low_mask = _mm_set1_epi8(0x0f);
+    __m128i total = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i lo = _mm_and_si128(v, low_mask);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low_mask);
+        __m128i counts = _mm_add_epi8(_mm_shuffle_epi8(lut, lo), _mm_shuffle_epi8(lut, hi));
+        total = _mm_add_epi64(total, _mm_sad_epu8(counts, _mm_setzero_si128()));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), total);
+    return lanes[0] + lanes[1] + popcountScalar(data + i, len - i);
+}
+
+__attribute__((target("sse2")))
+void maxBytesSSE(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_max_epu8(a, b));
+    }
+    maxBytesScalar(dst + i, src + i, len - i);
+}
+
+__attribute__((target("sse2")))
+void bitopSSE(BitOp op, uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i r;
+        switch (op) {
+            case BitOp::And: r = _mm_and_si128(a, b); break;
+            case BitOp::Or:  r = _mm_or_si128(a, b); break;
+            default:         r = _mm_xor_si128(a, b); break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), r);
+    }
+    bitopScalarTail(op, dst + i, src + i, len - i);
+}
+
+constexpr Kernels SSE_KERNELS{popcountSSE, maxBytesSSE, bitopSSE};
+
+// ---- AVX2 ---------------------------------------------------------------
+
+__attribute__((target("avx2")))
+uint64_t popcountAVX2(const uint8_t* data, size_t len) {
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i lo = _mm256_and_si256(v, low_mask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+        __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + popcountScalar(data + i, len - i);
+}
+
+__attribute__((target("avx2")))
+void maxBytesAVX2(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_max_epu8(a, b));
+    }
+    maxBytesScalar(dst + i, src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+void bitopAVX2(BitOp op, uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i r;
+        switch (op) {
+            case BitOp::And: r = _mm256_and_si256(a, b); break;
+            case BitOp::Or:  r = _mm256_or_si256(a, b); break;
+            default:         r = _mm256_xor_si256(a, b); break;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), r);
+    }
+    bitopScalarTail(op, dst + i, src + i, len - i);
+}
+
+constexpr Kernels AVX2_KERNELS{popcountAVX2, maxBytesAVX2, bitopAVX2};
+
+#endif // SIMD_KERNELS_X86
+
+Level supportedLevel() {
+#ifdef SIMD_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return Level::AVX2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return Level::SSE;
+    }
+#endif
+    return Level::Scalar;
+}
+
+const Kernels* kernelsFor(Level level) {
+#ifdef SIMD_KERNELS_X86
+    switch (level) {
+        case Level::AVX2: return &AVX2_KERNELS;
+        case Level::SSE:  return &SSE_KERNELS;
+        default: break;
+    }
+#else
+    (void)level;
+#endif
+    return &SCALAR_KERNELS;
+}
+
+std::atomic<const Kernels*> active{kernelsFor(supportedLevel())};
+
+const Kernels& kernels() {
+    return *active.load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+Level detectedLevel() {
+    static const Level level = supportedLevel();
+    return level;
+}
+
+const char* levelName(Level level) {
+    switch (level) {
+        case Level::AVX2: return "avx2";
+        case Level::SSE:  return "sse";
+        default:          return "scalar";
+    }
+}
+
+void setLevel(Level level) {
+    if (static_cast<int>(level) > static_cast<int>(detectedLevel())) {
+        level = detectedLevel();
+    }
+    active.store(kernelsFor(level), std::memory_order_relaxed);
+}
+
+uint64_t popcount(const uint8_t* data, size_t len) {
+    return kernels().popcount(data, len);
+}
+
+void maxBytes(uint8_t* dst, const uint8_t* src, size_t len) {
+    kernels().maxBytes(dst, src, len);
+}
+
+void bitop(BitOp op, uint8_t* dst, const uint8_t* src, size_t len) {
+    kernels().bitop(op, dst, src, len);
+}
+
+} // namespace simd
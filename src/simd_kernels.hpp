@@ -0,0 +1,34 @@
+#ifndef SIMD_KERNELS_HPP
+#define SIMD_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Byte-array kernels shared by the bitmap and HyperLogLog commands. The
+// implementation (AVX2, SSE or scalar) is chosen once at startup from the
+// CPU's capabilities.
+namespace simd {
+
+enum class Level { Scalar, SSE, AVX2 };
+
+Level detectedLevel();
+const char* levelName(Level level);
+
+// Forces a specific implementation; levels the CPU does not support fall
+// back to the best supported one. Intended for comparing implementations.
+void setLevel(Level level);
+
+// Number of set bits in data[0, len).
+uint64_t popcount(const uint8_t* data, size_t len);
+
+// dst[i] = max(dst[i], src[i]); merges HyperLogLog registers.
+void maxBytes(uint8_t* dst, const uint8_t* src, size_t len);
+
+enum class BitOp { And, Or, Xor };
+
+// dst[i] = dst[i] op src[i].
+void bitop(BitOp op, uint8_t* dst, const uint8_t* src, size_t len);
+
+} // namespace simd
+
+#endif // SIMD_KERNELS_HPP